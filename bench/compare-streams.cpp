@@ -0,0 +1,132 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+// Checks that every stream of the input pdf file is present byte for byte
+// in the output pdf file, as many times as in the input, and the output
+// has no other streams. Exit code is 1 if some stream is changed, 2 on
+// error. Streams are found by their "stream" and
+// "endstream" keywords, so only files with streams outside of object
+// streams are supported, like the ones written by make-test-pdf.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+
+typedef std::map<std::string, int> StreamCounts;
+
+bool ReadFile( const char* fileName, std::string & data )
+{
+    std::ifstream input( fileName, std::ios::binary );
+    if ( not input ) return false;
+    std::ostringstream contents;
+    contents << input.rdbuf();
+    data = contents.str();
+    return true;
+}
+
+bool GetStreams( const std::string & data, StreamCounts & streams )
+// Counts occurrences of every distinct stream data.
+// Returns false if some stream is not terminated.
+{
+    const std::string START = "stream";
+    const std::string END = "endstream";
+    size_t position = 0;
+    while ( ( position = data.find( START, position ) ) != std::string::npos )
+    {
+        // Skip "endstream" keywords themselves
+        if ( position >= 3 && data.compare( position - 3, 3, "end" ) == 0 )
+        {
+            position += START.size();
+            continue;
+        }
+        size_t begin = position + START.size();
+        // Keyword is followed by CRLF or LF (see Pdf Reference, ch. 3.2.7)
+        if ( data.compare( begin, 2, "\r\n" ) == 0 ) begin += 2;
+        else if ( data.compare( begin, 1, "\n" ) == 0 ) begin += 1;
+        else
+        {
+            position = begin;
+            continue;
+        }
+        size_t end = data.find( END, begin );
+        if ( end == std::string::npos ) return false;
+        // End of line before "endstream" is not a part of the data
+        size_t dataEnd = end;
+        if ( dataEnd > begin && data[dataEnd - 1] == '\n' ) --dataEnd;
+        if ( dataEnd > begin && data[dataEnd - 1] == '\r' ) --dataEnd;
+        ++streams[data.substr( begin, dataEnd - begin )];
+        position = end + END.size();
+    }
+    return true;
+}
+
+size_t CountMissing( const StreamCounts & streams,
+                     const StreamCounts & otherStreams, bool sameCount )
+// Returns number of distinct streams not found in otherStreams,
+// with sameCount also the ones found different number of times
+{
+    size_t missing = 0;
+    StreamCounts::const_iterator it;
+    for ( it = streams.begin(); it != streams.end(); ++it )
+    {
+        StreamCounts::const_iterator found = otherStreams.find( it->first );
+        if ( found == otherStreams.end()
+             || ( sameCount && found->second != it->second ) )
+            ++missing;
+    }
+    return missing;
+}
+
+int main( int argc, char* argv[] )
+{
+    if ( argc != 3 )
+    {
+        std::cout << "Usage: compare-streams in.pdf out.pdf" << std::endl;
+        return 2;
+    }
+    std::string input, output;
+    if ( not ReadFile( argv[1], input ) || not ReadFile( argv[2], output ) )
+    {
+        std::cout << "Can not read input files" << std::endl;
+        return 2;
+    }
+
+    StreamCounts inputStreams, outputStreams;
+    if ( not GetStreams( input, inputStreams )
+         || not GetStreams( output, outputStreams ) )
+    {
+        std::cout << "Unterminated stream in input files" << std::endl;
+        return 2;
+    }
+    size_t changed = CountMissing( inputStreams, outputStreams, true );
+    size_t added = CountMissing( outputStreams, inputStreams, false );
+    if ( changed > 0 || added > 0 )
+    {
+        std::cout << changed << " of " << inputStreams.size()
+                  << " distinct streams are changed in " << argv[2];
+        if ( added > 0 )
+            std::cout << ", " << added << " are not in " << argv[1];
+        std::cout << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,271 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+// Generator of synthetic pdf files for pdf-spot-disabler benchmarks.
+// Writes uncompressed PDF 1.4 with classic xref table, PoDoFo is not needed.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "getopt_pp.h"
+
+class PdfWriter
+// Writes numbered objects and remembers their offsets for xref table
+{
+public:
+    explicit PdfWriter( std::ostream & output )
+        : output( output )
+    {
+        output << "%PDF-1.4\n%\xE2\xE3\xCF\xD3\n";
+        // Object 0 is the head of the free list
+        offsets.push_back( 0 );
+    }
+
+    // Reserves object number, object is written later with WriteObject()
+    int Reserve()
+    {
+        offsets.push_back( 0 );
+        return offsets.size() - 1;
+    }
+
+    void WriteObject( int number, const std::string & body )
+    {
+        offsets[number] = output.tellp();
+        output << number << " 0 obj\n" << body << "\nendobj\n";
+    }
+
+    void WriteStream( int number, const std::string & data )
+    {
+        std::ostringstream body;
+        body << "<< /Length " << data.size() << " >>\nstream\n"
+             << data << "\nendstream";
+        WriteObject( number, body.str() );
+    }
+
+    void Finish( int catalog )
+    {
+        long xrefOffset = output.tellp();
+        output << "xref\n0 " << offsets.size() << "\n";
+        output << "0000000000 65535 f \n";
+        for ( size_t i = 1; i < offsets.size(); ++i )
+        {
+            output.width( 10 );
+            output.fill( '0' );
+            output << offsets[i] << " 00000 n \n";
+        }
+        output << "trailer\n<< /Size " << offsets.size()
+               << " /Root " << catalog << " 0 R >>\n"
+               << "startxref\n" << xrefOffset << "\n%%EOF\n";
+    }
+
+private:
+    std::ostream & output;
+    std::vector<long> offsets;
+};
+
+std::string Reference( int number )
+{
+    std::ostringstream reference;
+    reference << number << " 0 R";
+    return reference.str();
+}
+
+std::string SeparationArray( int spot )
+// [ /Separation name alternateSpace tintTransform ] for spot number
+{
+    std::ostringstream array;
+    array << "[ /Separation /Bench#20Spot#20" << spot << " /DeviceCMYK"
+          << " << /FunctionType 2 /Domain [ 0 1 ] /C0 [ 0 0 0 0 ]"
+          << " /C1 [ 0 " << ( spot % 10 ) / 10.0 << " 1 0 ] /N 1 >> ]";
+    return array.str();
+}
+
+std::string DeviceNArray( int spot, int tintTransform, bool cmyk )
+// [ /DeviceN names alternateSpace tintTransform ] with two spot colorants,
+// or with four process colorants and one spot colorant if cmyk is set
+{
+    std::ostringstream array;
+    array << "[ /DeviceN [ ";
+    if ( cmyk )
+        array << "/Cyan /Magenta /Yellow /Black /Bench#20Spot#20" << spot;
+    else
+        array << "/Bench#20Spot#20" << spot << " /Bench#20Spot#20" << spot
+              << "#20B";
+    array << " ] /DeviceCMYK " << Reference( tintTransform ) << " ]";
+    return array.str();
+}
+
+std::vector<int> WriteColorSpaces( PdfWriter & writer, int spotCount,
+                                   int tintTransform, bool cmyk,
+                                   std::string & colorSpaceDictionary )
+// Writes spotCount separation arrays, or DeviceN arrays if tintTransform
+// is not 0, returns ColorSpace dictionary
+{
+    std::vector<int> arrays;
+    std::ostringstream dictionary;
+    dictionary << "<<";
+    for ( int spot = 0; spot < spotCount; ++spot )
+    {
+        int array = writer.Reserve();
+        writer.WriteObject( array, tintTransform != 0
+                                       ? DeviceNArray( spot, tintTransform,
+                                                       cmyk )
+                                       : SeparationArray( spot ) );
+        arrays.push_back( array );
+        dictionary << " /CS" << spot << " " << Reference( array );
+    }
+    dictionary << " >>";
+    colorSpaceDictionary = dictionary.str();
+    return arrays;
+}
+
+std::string PageContent( int pageNumber, int spotCount, bool deviceN,
+                         bool cmyk, size_t streamBytes )
+// Content stream painting one rectangle per spot, padded to streamBytes
+{
+    const char* color = not deviceN ? " cs 1 scn "
+                                    : cmyk ? " cs 0 0 0 0 1 scn "
+                                           : " cs 1 1 scn ";
+    std::ostringstream content;
+    // Every page gets distinct stream data
+    content << "% page " << pageNumber << "\n";
+    for ( int spot = 0; spot < spotCount; ++spot )
+    {
+        content << "/CS" << spot << color << ( spot % 20 ) * 25 << " "
+                << ( spot / 20 ) * 25 << " 20 20 re f\n";
+    }
+    std::string data = content.str();
+    // Comments are a cheap way to make content of any size
+    while ( data.size() < streamBytes )
+        data.append( "% padding of benchmark content stream ......\n" );
+    return data;
+}
+
+int main( int argc, char* argv[] )
+{
+    GetOpt::GetOpt_pp commandLine( argc, argv );
+    if ( argc < 2 || commandLine >> GetOpt::OptionPresent('h', "help") )
+    {
+        std::cout << "Usage: make-test-pdf out.pdf [-p pages] [-s spots]"
+                  << " [-b stream-bytes] [--per-page] [--device-n [--cmyk]]"
+                  << std::endl;
+        std::cout << "  --per-page   every page gets its own color spaces,"
+                  << " otherwise one resource dictionary is shared."
+                  << std::endl;
+        std::cout << "  --device-n   color spaces are DeviceN with two"
+                  << " colorants instead of Separation." << std::endl;
+        std::cout << "  --cmyk       DeviceN color spaces have /Cyan /Magenta"
+                  << " /Yellow /Black and one spot colorant." << std::endl;
+        return 0;
+    }
+    int pageCount = 100;
+    int spotCount = 4;
+    size_t streamBytes = 4096;
+    commandLine >> GetOpt::Option('p', "pages", pageCount);
+    commandLine >> GetOpt::Option('s', "spots", spotCount);
+    commandLine >> GetOpt::Option('b', "stream-bytes", streamBytes);
+    std::vector<std::string> fileNames;
+    commandLine >> GetOpt::GlobalOption(fileNames);
+    bool perPage = commandLine >> GetOpt::OptionPresent('\0', "per-page");
+    bool deviceN = commandLine >> GetOpt::OptionPresent('\0', "device-n");
+    bool cmyk = commandLine >> GetOpt::OptionPresent('\0', "cmyk");
+
+    if ( fileNames.size() != 1 || pageCount < 1 || spotCount < 0
+         || ( cmyk && not deviceN ) )
+    {
+        std::cout << "Invalid command line option provided!" << std::endl;
+        return 1;
+    }
+    std::ofstream output( fileNames[0].c_str(), std::ios::binary );
+    if ( not output )
+    {
+        std::cout << "Can not create " << fileNames[0] << std::endl;
+        return 1;
+    }
+
+    PdfWriter writer( output );
+    int catalog = writer.Reserve();
+    int pages = writer.Reserve();
+    writer.WriteObject( catalog, "<< /Type /Catalog /Pages "
+                                 + Reference( pages ) + " >>" );
+
+    // DeviceN arrays share one PostScript calculator tint transform
+    int tintTransform = 0;
+    if ( deviceN )
+    {
+        tintTransform = writer.Reserve();
+        // Spot of CMYK arrays is dropped, process colorants are kept
+        writer.WriteObject( tintTransform, cmyk
+                        ? "<< /FunctionType 4 /Domain [ 0 1 0 1 0 1 0 1 0 1 ]"
+                          " /Range [ 0 1 0 1 0 1 0 1 ] /Length 7 >>\n"
+                          "stream\n{ pop }\nendstream"
+                        : "<< /FunctionType 4 /Domain [ 0 1 0 1 ]"
+                          " /Range [ 0 1 0 1 0 1 0 1 ] /Length 18 >>\n"
+                          "stream\n{ pop 0 exch 0 0 }\nendstream" );
+    }
+
+    int sharedResources = 0;
+    if ( not perPage )
+    {
+        std::string colorSpaces;
+        WriteColorSpaces( writer, spotCount, tintTransform, cmyk,
+                              colorSpaces );
+        sharedResources = writer.Reserve();
+        writer.WriteObject( sharedResources,
+                            "<< /ColorSpace " + colorSpaces + " >>" );
+    }
+
+    std::ostringstream kids;
+    for ( int pn = 0; pn < pageCount; ++pn )
+    {
+        std::string resources;
+        if ( perPage )
+        {
+            std::string colorSpaces;
+            WriteColorSpaces( writer, spotCount, tintTransform, cmyk,
+                              colorSpaces );
+            resources = "<< /ColorSpace " + colorSpaces + " >>";
+        }
+        else
+        {
+            resources = Reference( sharedResources );
+        }
+        int contents = writer.Reserve();
+        writer.WriteStream( contents,
+                            PageContent( pn, spotCount, deviceN, cmyk,
+                                         streamBytes ) );
+        int page = writer.Reserve();
+        writer.WriteObject( page, "<< /Type /Page /Parent " + Reference( pages )
+                                  + " /MediaBox [ 0 0 595 842 ] /Resources "
+                                  + resources + " /Contents "
+                                  + Reference( contents ) + " >>" );
+        kids << " " << Reference( page );
+    }
+
+    std::ostringstream pagesBody;
+    pagesBody << "<< /Type /Pages /Count " << pageCount
+              << " /Kids [" << kids.str() << " ] >>";
+    writer.WriteObject( pages, pagesBody.str() );
+    writer.Finish( catalog );
+    return output ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+#!/bin/sh
+# Copyright (C) 2013 Pavlo Oleshkevych <oleshkevych@gmail.com>
+#
+# This file is free software; as a special exception the author gives
+# unlimited permission to copy and/or distribute it, with or without
+# modifications, as long as this notice is preserved.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY, to the extent permitted by law; without even the
+# implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+# Benchmark of pdf-spot-disabler on synthetic pdf files.
+# Usage: run-bench.sh pdf-spot-disabler make-test-pdf compare-streams [work-dir]
+# Every case is generated by make-test-pdf and processed with --stats,
+# phase times are taken from the JSON the tool prints to stderr.
+# Outputs are checked with compare-streams: every stream of the input
+# must be written byte for byte, without decoding and encoding again,
+# a changed stream fails the benchmark.
+
+TOOL=$1
+GENERATOR=$2
+COMPARE=$3
+WORK_DIR=${4:-bench-work}
+
+if test ! -x "$TOOL" || test ! -x "$GENERATOR" || test ! -x "$COMPARE"; then
+    echo "Usage: $0 pdf-spot-disabler make-test-pdf compare-streams [work-dir]"
+    exit 1
+fi
+mkdir -p "$WORK_DIR" || exit 1
+
+# Value of numeric "key": from JSON object in file $1, key may be
+# prefixed with parent object like load\":{\"wall_s
+json_value()
+{
+    sed -n "s/.*\"$2\":\([-0-9.e+]*\).*/\1/p" "$1"
+}
+
+# pages spots stream-bytes [make-test-pdf options]. DeviceN cases mirror
+# Separation ones, so both color space kinds can be compared directly.
+CASES="1000:8:4096:
+1000:8:4096:--per-page
+1000:8:4096:--device-n
+1000:8:4096:--per-page --device-n
+200:4:262144:
+50:4:4194304:
+50:200:4096:--per-page"
+
+printf "%-36s %-12s %8s %8s %8s %8s %8s %8s %10s %8s %8s\n" \
+       case mode load scan rewrite write total cpu pages/s MB/s streams
+
+# Loop reads from a here-document, not from a pipe, so that it runs in
+# this shell and exit on a failed case ends the whole benchmark
+while IFS=: read PAGES SPOTS BYTES LAYOUT; do
+    NAME="p${PAGES}-s${SPOTS}-b${BYTES}$(echo "$LAYOUT" | sed 's/ *--/-/g')"
+    INPUT="$WORK_DIR/$NAME.pdf"
+    "$GENERATOR" "$INPUT" -p "$PAGES" -s "$SPOTS" -b "$BYTES" $LAYOUT \
+        > /dev/null || exit 1
+
+    for MODE in list disable incremental; do
+        STATS="$WORK_DIR/$NAME-$MODE.json"
+        case $MODE in
+            list) "$TOOL" "$INPUT" -l --stats > /dev/null 2> "$STATS" ;;
+            disable) "$TOOL" "$INPUT" "$WORK_DIR/$NAME-out.pdf" 0 1 \
+                         --stats > /dev/null 2> "$STATS" ;;
+            incremental) "$TOOL" "$INPUT" "$WORK_DIR/$NAME-out.pdf" 0 1 \
+                             -i --stats > /dev/null 2> "$STATS" ;;
+        esac || { echo "$NAME $MODE failed"; exit 1; }
+
+        STREAMS=-
+        if test $MODE != list; then
+            if "$COMPARE" "$INPUT" "$WORK_DIR/$NAME-out.pdf" > /dev/null; then
+                STREAMS=same
+            else
+                STREAMS=CHANGED
+            fi
+        fi
+
+        TOTAL=$(json_value "$STATS" wall_s)
+        CPU=$(json_value "$STATS" cpu_s)
+        PAGES_DONE=$(json_value "$STATS" pages)
+        INPUT_BYTES=$(json_value "$STATS" input_bytes)
+        awk -v name="$NAME" -v mode="$MODE" \
+            -v load="$(json_value "$STATS" 'load":{"wall_s')" \
+            -v scan="$(json_value "$STATS" 'scan":{"wall_s')" \
+            -v rewrite="$(json_value "$STATS" 'rewrite":{"wall_s')" \
+            -v write="$(json_value "$STATS" 'write":{"wall_s')" \
+            -v total="$TOTAL" -v cpu="$CPU" -v streams="$STREAMS" \
+            -v pages="$PAGES_DONE" -v bytes="$INPUT_BYTES" \
+            'BEGIN {
+                 if ( total <= 0 ) total = 1e-9
+                 printf "%-36s %-12s %8.4f %8.4f %8.4f %8.4f %8.4f %8.4f %10.0f %8.1f %8s\n",
+                        name, mode, load, scan, rewrite, write, total, cpu,
+                        pages / total, bytes / total / 1048576, streams
+             }'
+        if test "$STREAMS" = CHANGED; then
+            echo "$NAME $MODE: streams are changed"
+            exit 1
+        fi
+    done
+done <<EOF
+$CASES
+EOF
+
+# Process colorants of DeviceN arrays are not spots: only the spot of
+# every [ /Cyan /Magenta /Yellow /Black spot ] array must be listed
+INPUT="$WORK_DIR/cmyk-device-n.pdf"
+"$GENERATOR" "$INPUT" -p 1 -s 2 --device-n --cmyk > /dev/null || exit 1
+"$TOOL" "$INPUT" -l > "$WORK_DIR/cmyk-device-n.txt" \
+    || { echo "cmyk-device-n failed"; exit 1; }
+if test "$(sort "$WORK_DIR/cmyk-device-n.txt")" != "Bench Spot 0
+Bench Spot 1"; then
+    echo "cmyk-device-n: process colorants are listed as spots"
+    exit 1
+fi
+
+# A failed variant must leave the loaded document as it was: the first
+# variant disables every spot and fails to write, the second one matches
+# no spot, so its output must still list all spots of the input
+INPUT="$WORK_DIR/variants.pdf"
+"$GENERATOR" "$INPUT" -p 4 -s 3 > /dev/null || exit 1
+"$TOOL" "$INPUT" -l > "$WORK_DIR/variants-in.txt" \
+    || { echo "variants: listing failed"; exit 1; }
+printf '%s\n%s\t%s\n' "$WORK_DIR/missing-dir/variant-1.pdf" \
+       "$WORK_DIR/variant-2.pdf" "No Such Spot" > "$WORK_DIR/variants.txt"
+rm -f "$WORK_DIR/variant-2.pdf"
+"$TOOL" "$INPUT" -v "$WORK_DIR/variants.txt" > "$WORK_DIR/variants-out.txt"
+if ! grep -q '^FAILED' "$WORK_DIR/variants-out.txt" \
+   || ! grep -q '^OK' "$WORK_DIR/variants-out.txt"; then
+    echo "variants: expected one failed and one written variant"
+    exit 1
+fi
+"$TOOL" "$WORK_DIR/variant-2.pdf" -l > "$WORK_DIR/variant-2.txt" \
+    || { echo "variants: listing of variant 2 failed"; exit 1; }
+if ! cmp -s "$WORK_DIR/variants-in.txt" "$WORK_DIR/variant-2.txt"; then
+    echo "variants: spots disabled by the failed variant are not restored"
+    exit 1
+fi
+
+# Peak memory on a large fixture: streams are held once, by the document
+# itself, so resident size must stay well below twice the input size.
+# Limit is MAX_RSS_RATIO times the input plus a fixed allowance.
+# The first run records peak RSS in RSS_BASELINE, later runs fail if it
+# grows by more than RSS_TOLERANCE percent over the recorded one, so a
+# second copy of the objects shows up even below the ratio limit.
+# Remove the baseline file to record it again after an intended change.
+MAX_RSS_RATIO=${MAX_RSS_RATIO:-1.5}
+RSS_BASELINE=${RSS_BASELINE:-$WORK_DIR/memory-baseline.txt}
+RSS_TOLERANCE=${RSS_TOLERANCE:-10}
+INPUT="$WORK_DIR/memory.pdf"
+STATS="$WORK_DIR/memory.json"
+"$GENERATOR" "$INPUT" -p 50 -s 4 -b 4194304 > /dev/null || exit 1
+"$TOOL" "$INPUT" "$WORK_DIR/memory-out.pdf" 0 1 --stats > /dev/null \
+    2> "$STATS" || { echo "memory case failed"; exit 1; }
+RSS=$(json_value "$STATS" peak_rss_kb)
+if test -z "$RSS"; then
+    echo "memory: peak RSS is not reported"
+    exit 1
+fi
+test -s "$RSS_BASELINE" || echo "$RSS" > "$RSS_BASELINE" || exit 1
+echo
+printf "%-12s %12s %12s %12s %12s\n" \
+       memory input_kb peak_rss_kb limit_kb baseline_kb
+awk -v bytes="$(json_value "$STATS" input_bytes)" \
+    -v rss="$RSS" -v ratio="$MAX_RSS_RATIO" \
+    -v baseline="$(cat "$RSS_BASELINE")" -v tolerance="$RSS_TOLERANCE" \
+    'BEGIN {
+         limit = bytes / 1024 * ratio + 65536
+         printf "%-12s %12.0f %12.0f %12.0f %12.0f\n", "disable",
+                bytes / 1024, rss, limit, baseline
+         if ( rss > limit ) {
+             print "memory: peak RSS over the limit"
+             exit 1
+         }
+         if ( rss > baseline * ( 1 + tolerance / 100 ) ) {
+             printf "memory: peak RSS grew by %.0f%% over the baseline\n",
+                    ( rss / baseline - 1 ) * 100
+             exit 1
+         }
+     }' || exit 1
+
+# Page scanning scaling on a large catalog: -j 1 up to the number
+# of processors, the spot list must not depend on the thread count
+CPUS=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)
+INPUT="$WORK_DIR/scaling.pdf"
+"$GENERATOR" "$INPUT" -p 5000 -s 8 -b 256 --per-page > /dev/null || exit 1
+echo
+printf "%-8s %8s %8s %8s %8s\n" threads load scan total speedup
+JOBS=1
+while test "$JOBS" -le "$CPUS"; do
+    STATS="$WORK_DIR/scaling-j$JOBS.json"
+    "$TOOL" "$INPUT" -l -j "$JOBS" --stats > "$WORK_DIR/scaling-j$JOBS.txt" \
+        2> "$STATS" || { echo "scaling -j $JOBS failed"; exit 1; }
+    if ! cmp -s "$WORK_DIR/scaling-j1.txt" "$WORK_DIR/scaling-j$JOBS.txt"; then
+        echo "scaling -j $JOBS: spot list differs from -j 1"
+        exit 1
+    fi
+    SCAN=$(json_value "$STATS" 'scan":{"wall_s')
+    test "$JOBS" -eq 1 && SERIAL_SCAN=$SCAN
+    awk -v jobs="$JOBS" -v load="$(json_value "$STATS" 'load":{"wall_s')" \
+        -v scan="$SCAN" -v serial="$SERIAL_SCAN" \
+        -v total="$(json_value "$STATS" wall_s)" \
+        'BEGIN {
+             if ( scan <= 0 ) scan = 1e-9
+             printf "%-8d %8.4f %8.4f %8.4f %8.2f\n",
+                    jobs, load, scan, total, serial / scan
+         }'
+    if test "$JOBS" -lt "$CPUS" && test $((JOBS * 2)) -gt "$CPUS"; then
+        JOBS=$CPUS
+    else
+        JOBS=$((JOBS * 2))
+    fi
+done
@@ -0,0 +1,20 @@
+dnl Copyright (C) 1998 Eleftherios Gkioulekas <lf@amath.washington.edu>
+dnl
+dnl This file is free software; as a special exception the author gives
+dnl unlimited permission to copy and/or distribute it, with or without
+dnl modifications, as long as this notice is preserved.
+dnl
+dnl This program is distributed in the hope that it will be useful, but
+dnl WITHOUT ANY WARRANTY, to the extent permitted by law; without even the
+dnl implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+dnl
+dnl Macro of autotoolset, kept here so that configure can be regenerated
+dnl on systems without autotoolset installed.
+
+AC_DEFUN([LF_CONFIGURE_CC],[
+  dnl Initialize the C compiler
+  AC_REQUIRE([AC_PROG_CC])
+  AC_REQUIRE([AC_PROG_CPP])
+  AC_REQUIRE([AC_USE_SYSTEM_EXTENSIONS])
+  AC_SEARCH_LIBS([strerror],[cposix])
+])
@@ -0,0 +1,49 @@
+dnl Copyright (C) 1998 Eleftherios Gkioulekas <lf@amath.washington.edu>
+dnl
+dnl This file is free software; as a special exception the author gives
+dnl unlimited permission to copy and/or distribute it, with or without
+dnl modifications, as long as this notice is preserved.
+dnl
+dnl This program is distributed in the hope that it will be useful, but
+dnl WITHOUT ANY WARRANTY, to the extent permitted by law; without even the
+dnl implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+dnl
+dnl Macro of autotoolset, kept here so that configure can be regenerated
+dnl on systems without autotoolset installed.
+
+AC_DEFUN([LF_CPP_PORTABILITY],[
+  dnl Check for common C++ portability problems
+  AC_LANG_PUSH([C++])
+
+  AC_MSG_CHECKING([whether C++ has bool])
+  AC_RUN_IFELSE([AC_LANG_SOURCE([[int main() { bool b1=true; bool b2=false; return 0; }]])],
+    [ AC_MSG_RESULT([yes]) ],
+    [ AC_MSG_RESULT([no])
+      AC_DEFINE([CXX_HAS_NO_BOOL],[1],[C++ compiler has no bool type]) ],
+    [ AC_MSG_WARN([Don't cross-compile]) ])
+
+  AC_MSG_CHECKING([whether C++ has buggy scoping in for-loops])
+  AC_COMPILE_IFELSE([AC_LANG_PROGRAM([[]],[[
+     for (int i=0;i<10;i++) { }
+     for (int i=0;i<10;i++) { }
+  ]])],
+    [ AC_MSG_RESULT([no]) ],
+    [ AC_MSG_RESULT([yes])
+      AC_DEFINE([CXX_HAS_BUGGY_FOR_LOOPS],[1],[C++ for-loop scoping is broken]) ])
+
+  AC_MSG_CHECKING([whether user wants assertions])
+  AC_ARG_ENABLE([assert],
+    [AS_HELP_STRING([--disable-assert],[turn off assertions])],
+    [ AC_DEFINE([NDEBUG],[1],[Assertions are disabled])
+      AC_MSG_RESULT([no]) ],
+    [ AC_MSG_RESULT([yes]) ])
+
+  AC_LANG_POP([C++])
+])
+
+AC_DEFUN([LF_CONFIGURE_CXX],[
+  dnl Initialize the C++ compiler
+  AC_REQUIRE([AC_PROG_CXX])
+  AC_REQUIRE([AC_PROG_CXXCPP])
+  LF_CPP_PORTABILITY
+])
@@ -0,0 +1,68 @@
+dnl Copyright (C) 1998 Eleftherios Gkioulekas <lf@amath.washington.edu>
+dnl
+dnl This file is free software; as a special exception the author gives
+dnl unlimited permission to copy and/or distribute it, with or without
+dnl modifications, as long as this notice is preserved.
+dnl
+dnl This program is distributed in the hope that it will be useful, but
+dnl WITHOUT ANY WARRANTY, to the extent permitted by law; without even the
+dnl implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+dnl
+dnl Macro of autotoolset, kept here so that configure can be regenerated
+dnl on systems without autotoolset installed.
+
+AC_DEFUN([LF_CHECK_CC_FLAG],[
+  echo 'void f(){}' > conftest.c
+  for i in $1
+  do
+    AC_MSG_CHECKING([whether $CC accepts $i])
+    if test -z "`${CC} $i -c conftest.c 2>&1`"
+    then
+      CFLAGS="${CFLAGS} $i"
+      AC_MSG_RESULT([yes])
+    else
+      AC_MSG_RESULT([no])
+    fi
+  done
+  rm -f conftest.c conftest.o
+])
+
+AC_DEFUN([LF_CHECK_CXX_FLAG],[
+  echo 'void f(){}' > conftest.cc
+  for i in $1
+  do
+    AC_MSG_CHECKING([whether $CXX accepts $i])
+    if test -z "`${CXX} $i -c conftest.cc 2>&1`"
+    then
+      CXXFLAGS="${CXXFLAGS} $i"
+      AC_MSG_RESULT([yes])
+    else
+      AC_MSG_RESULT([no])
+    fi
+  done
+  rm -f conftest.cc conftest.o
+])
+
+AC_DEFUN([LF_SET_WARNINGS],[
+  dnl Check for --with-warnings
+  AC_MSG_CHECKING([whether user wants warnings])
+  AC_ARG_WITH([warnings],
+    [AS_HELP_STRING([--with-warnings],[Turn on warnings])],
+    [ lf_warnings=yes ], [ lf_warnings=no ])
+  AC_MSG_RESULT([$lf_warnings])
+
+  dnl Warnings for the two main compilers
+  cc_warning_flags="-Wall"
+  cxx_warning_flags="-Wall -Woverloaded-virtual"
+  if test $lf_warnings = yes
+  then
+    if test -n "${CC}"
+    then
+      LF_CHECK_CC_FLAG($cc_warning_flags)
+    fi
+    if test -n "${CXX}"
+    then
+      LF_CHECK_CXX_FLAG($cxx_warning_flags)
+    fi
+  fi
+])
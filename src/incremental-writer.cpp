@@ -0,0 +1,299 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "incremental-writer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+
+// Pdf Reference, ch. 3.4.4: startxref is in the last 1024 bytes of file
+const size_t TAIL_SIZE = 1024;
+const size_t COPY_BUFFER_SIZE = 1 << 20;
+
+void WriteString( PoDoFo::PdfOutputDevice & outputDevice,
+                  const std::string & data )
+{
+    outputDevice.Write( data.data(), data.size() );
+}
+
+void KeepTail( std::string & tail, const char* data, size_t size )
+// Appends data to tail and keeps only its last TAIL_SIZE bytes
+{
+    if ( size >= TAIL_SIZE )
+    {
+        tail.assign( data + size - TAIL_SIZE, TAIL_SIZE );
+        return;
+    }
+    tail.append( data, size );
+    if ( tail.size() > TAIL_SIZE ) tail.erase( 0, tail.size() - TAIL_SIZE );
+}
+
+std::string CopySource( const PdfSource & source,
+                        PoDoFo::PdfOutputDevice & outputDevice )
+// Writes source bytes to outputDevice, returns the end of source
+{
+    std::string tail;
+    if ( source.data != NULL )
+    {
+        outputDevice.Write( source.data, source.size );
+        KeepTail( tail, source.data, source.size );
+        return tail;
+    }
+    std::ifstream input( source.fileName.c_str(), std::ios::binary );
+    if ( not input )
+        throw std::runtime_error( "can not read " + source.fileName );
+    std::string buffer( COPY_BUFFER_SIZE, '\0' );
+    while ( input.read( &buffer[0], buffer.size() ) || input.gcount() > 0 )
+    {
+        outputDevice.Write( buffer.data(), input.gcount() );
+        KeepTail( tail, buffer.data(), input.gcount() );
+    }
+    if ( input.bad() )
+        throw std::runtime_error( "can not read " + source.fileName );
+    return tail;
+}
+
+unsigned long long GetPreviousXRefOffset( const std::string & tail )
+// Offset written after the last startxref keyword of the file
+{
+    size_t keyword = tail.rfind( "startxref" );
+    if ( keyword == std::string::npos )
+        throw std::runtime_error( "startxref not found at the end of file" );
+    const char* digits = tail.c_str() + keyword + strlen( "startxref" );
+    char* end;
+    unsigned long long offset = strtoull( digits, &end, 10 );
+    if ( end == digits )
+        throw std::runtime_error( "invalid startxref offset" );
+    return offset;
+}
+
+bool IsXRefStream( const PdfSource & source, unsigned long long offset )
+// True if cross-reference section at offset of source is an xref stream
+// object "N G obj" rather than a table starting with "xref" keyword
+{
+    const size_t HEAD_SIZE = 32;
+    std::string head;
+    if ( source.data != NULL )
+    {
+        if ( offset >= source.size ) return false;
+        head.assign( source.data + offset,
+                     std::min<unsigned long long>( HEAD_SIZE,
+                                                   source.size - offset ) );
+    }
+    else
+    {
+        std::ifstream input( source.fileName.c_str(), std::ios::binary );
+        if ( not input.seekg( offset ) ) return false;
+        head.resize( HEAD_SIZE );
+        input.read( &head[0], head.size() );
+        head.resize( input.gcount() );
+    }
+    unsigned long number, generation;
+    char keyword[4] = "";
+    return sscanf( head.c_str(), "%lu %lu %3s", &number, &generation,
+                   keyword ) == 3
+           && strcmp( keyword, "obj" ) == 0;
+}
+
+int ByteWidth( unsigned long long value )
+// Number of bytes needed for value, at least 1
+{
+    int width = 1;
+    while ( width < 8 && ( value >> ( 8 * width ) ) != 0 ) ++width;
+    return width;
+}
+
+void AppendBigEndian( std::string & data, unsigned long long value,
+                      int width )
+{
+    for ( int i = width - 1; i >= 0; --i )
+        data.push_back( static_cast<char>( ( value >> ( 8 * i ) ) & 0xFF ) );
+}
+
+std::string Serialize( const PoDoFo::PdfVariant & value )
+// Returns pdf syntax of value
+{
+    std::ostringstream output;
+    {
+        PoDoFo::PdfOutputDevice device( &output );
+        value.Write( &device, PoDoFo::ePdfWriteMode_Compact, NULL );
+        device.Flush();
+    }
+    return output.str();
+}
+
+} // namespace
+
+unsigned long long WriteIncremental( PoDoFo::PdfMemDocument & pdfDocument,
+            const PdfSource & source,
+            const std::vector<const PoDoFo::PdfObject*> & changedObjects,
+            PoDoFo::PdfOutputDevice & outputDevice )
+{
+    const PoDoFo::PdfObject* trailer = pdfDocument.GetTrailer();
+    if ( trailer == NULL || trailer->GetDictionary().HasKey( "Encrypt" ) )
+        throw std::runtime_error( "incremental update of encrypted or "
+                                  "empty document is not supported" );
+
+    // Every object is written once, ordered by number for xref subsections
+    std::map<PoDoFo::PdfReference, const PoDoFo::PdfObject*> objects;
+    for ( size_t i = 0; i < changedObjects.size(); ++i )
+    {
+        if ( changedObjects[i] != NULL
+             && changedObjects[i]->Reference().IsIndirect() )
+            objects[changedObjects[i]->Reference()] = changedObjects[i];
+    }
+
+    const unsigned long long start = outputDevice.GetLength();
+    const std::string tail = CopySource( source, outputDevice );
+    // Without changes the output is the source byte for byte
+    if ( objects.empty() )
+    {
+        outputDevice.Flush();
+        return outputDevice.GetLength() - start;
+    }
+    const unsigned long long previousXRef = GetPreviousXRefOffset( tail );
+    // Update section must start on a new line
+    if ( not tail.empty() && tail[tail.size() - 1] != '\n'
+         && tail[tail.size() - 1] != '\r' )
+        WriteString( outputDevice, "\n" );
+
+    std::map<PoDoFo::PdfReference, unsigned long long> offsets;
+    std::map<PoDoFo::PdfReference, const PoDoFo::PdfObject*>::const_iterator it;
+    for ( it = objects.begin(); it != objects.end(); ++it )
+    {
+        offsets[it->first] = outputDevice.GetLength() - start;
+        it->second->WriteObject( &outputDevice,
+                                 PoDoFo::ePdfWriteMode_Compact, NULL );
+    }
+
+    // Size covers objects of all sections, others are kept from the source
+    unsigned long long size = 0;
+    const PoDoFo::PdfObject* previousSize
+                                = trailer->GetDictionary().GetKey( "Size" );
+    if ( previousSize != NULL && previousSize->IsNumber() )
+        size = previousSize->GetNumber();
+    if ( offsets.rbegin()->first.ObjectNumber() >= size )
+        size = offsets.rbegin()->first.ObjectNumber() + 1;
+
+    std::ostringstream trailerKeys;
+    const PoDoFo::TKeyMap & keys = trailer->GetDictionary().GetKeys();
+    PoDoFo::TKeyMap::const_iterator key;
+    for ( key = keys.begin(); key != keys.end(); ++key )
+    {
+        if ( key->first == PoDoFo::PdfName( "Root" )
+             || key->first == PoDoFo::PdfName( "Info" )
+             || key->first == PoDoFo::PdfName( "ID" ) )
+            trailerKeys << "/" << key->first.GetEscapedName()
+                        << Serialize( *key->second );
+    }
+    trailerKeys << "/Prev " << previousXRef;
+
+    const unsigned long long xrefOffset = outputDevice.GetLength() - start;
+    /* Reader following /Prev of a table to an xref stream may not know
+     * xref streams at all, so a source ending with an xref stream is
+     * updated with an xref stream, a source ending with a table with
+     * a table (see Pdf Reference, ch. 3.4.7).
+     */
+    if ( IsXRefStream( source, previousXRef ) )
+    {
+        // Xref stream is a new object after all others and describes
+        // itself too
+        offsets[PoDoFo::PdfReference( size, 0 )] = xrefOffset;
+        const int offsetWidth = ByteWidth( xrefOffset );
+        std::ostringstream index;
+        std::string xrefData;
+        std::map<PoDoFo::PdfReference, unsigned long long>::const_iterator
+                                                    entry = offsets.begin();
+        while ( entry != offsets.end() )
+        {
+            const unsigned long first = entry->first.ObjectNumber();
+            size_t runLength = 0;
+            for ( ; entry != offsets.end()
+                    && entry->first.ObjectNumber() == first + runLength;
+                  ++entry, ++runLength )
+            {
+                AppendBigEndian( xrefData, 1, 1 );
+                AppendBigEndian( xrefData, entry->second, offsetWidth );
+                AppendBigEndian( xrefData, entry->first.GenerationNumber(),
+                                 2 );
+            }
+            index << ( index.tellp() > 0 ? " " : "" ) << first << " "
+                  << runLength;
+        }
+        std::ostringstream xrefStream;
+        xrefStream << size << " 0 obj\n<</Type/XRef/Size " << size + 1
+                   << "/W[1 " << offsetWidth << " 2]/Index[" << index.str()
+                   << "]" << trailerKeys.str() << "/Length "
+                   << xrefData.size() << ">>\nstream\n" << xrefData
+                   << "\nendstream\nendobj\nstartxref\n" << xrefOffset
+                   << "\n%%EOF\n";
+        WriteString( outputDevice, xrefStream.str() );
+        outputDevice.Flush();
+        return outputDevice.GetLength() - start;
+    }
+
+    /* Subsection is a run of consecutive object numbers, every entry
+     * is exactly 20 bytes long (see Pdf Reference, ch. 3.4.3)
+     */
+    WriteString( outputDevice, "xref\n" );
+    std::map<PoDoFo::PdfReference, unsigned long long>::const_iterator entry
+                                                            = offsets.begin();
+    while ( entry != offsets.end() )
+    {
+        std::map<PoDoFo::PdfReference, unsigned long long>::const_iterator
+                                                            runEnd = entry;
+        size_t runLength = 0;
+        while ( runEnd != offsets.end()
+                && runEnd->first.ObjectNumber()
+                       == entry->first.ObjectNumber() + runLength )
+        {
+            ++runEnd;
+            ++runLength;
+        }
+        std::ostringstream subsection;
+        subsection << entry->first.ObjectNumber() << " " << runLength << "\n";
+        WriteString( outputDevice, subsection.str() );
+        for ( ; entry != runEnd; ++entry )
+        {
+            char line[32];
+            snprintf( line, sizeof(line), "%010llu %05u n\r\n",
+                      entry->second,
+                      static_cast<unsigned>(
+                                    entry->first.GenerationNumber() ) );
+            WriteString( outputDevice, line );
+        }
+    }
+
+    std::ostringstream trailerText;
+    trailerText << "trailer\n<</Size " << size << trailerKeys.str()
+                << ">>\nstartxref\n" << xrefOffset << "\n%%EOF\n";
+    WriteString( outputDevice, trailerText.str() );
+    outputDevice.Flush();
+    return outputDevice.GetLength() - start;
+}
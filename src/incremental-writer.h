@@ -0,0 +1,40 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef INCREMENTAL_WRITER_H
+#define INCREMENTAL_WRITER_H
+
+#include <vector>
+#include <podofo/podofo.h>
+#include "spot-disabler.h"
+
+// Writes source pdf file as is, followed by incremental update section
+// with changedObjects, cross-reference table of them and trailer pointing
+// to the previous cross-reference section (see Pdf Reference, ch. 3.4.5).
+// If the previous section is an xref stream, the new one is an xref
+// stream too. Without changedObjects only the source is written.
+// pdfDocument must be loaded from source.
+// Returns number of bytes written. Encrypted documents are not supported.
+unsigned long long WriteIncremental( PoDoFo::PdfMemDocument & pdfDocument,
+            const PdfSource & source,
+            const std::vector<const PoDoFo::PdfObject*> & changedObjects,
+            PoDoFo::PdfOutputDevice & outputDevice );
+
+#endif // INCREMENTAL_WRITER_H
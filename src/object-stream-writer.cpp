@@ -0,0 +1,344 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "object-stream-writer.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <zlib.h>
+
+#include "worker-pool.h"
+
+namespace
+{
+
+// Objects per object stream. Bigger streams compress better,
+// but reader has to inflate the whole stream to get any of them.
+const size_t OBJECTS_PER_STREAM = 200;
+
+struct XRefEntry
+// Entry of cross-reference stream (see Pdf Reference, table 3.16)
+{
+    XRefEntry() : type( 0 ), field2( 0 ), field3( 0 ) {}
+    XRefEntry( int type, unsigned long long field2, unsigned int field3 )
+        : type( type ), field2( field2 ), field3( field3 ) {}
+    int type;
+    unsigned long long field2;
+    unsigned int field3;
+};
+
+struct ObjectStream
+// Objects packed into one object stream
+{
+    std::vector<PoDoFo::pdf_uint32> objectNumbers;
+    // Pairs of object number and offset of object in data
+    std::string header;
+    std::string data;
+    std::string compressed;
+};
+
+class CompressTask : public WorkerTask
+// Deflates header and data of object stream
+{
+public:
+    explicit CompressTask( ObjectStream & objectStream )
+        : objectStream( objectStream ), failed( false ) {}
+
+    void Run()
+    {
+        std::string source = objectStream.header + objectStream.data;
+        uLongf size = compressBound( source.size() );
+        objectStream.compressed.resize( size );
+        failed = compress2( reinterpret_cast<Bytef*>(
+                                &objectStream.compressed[0] ),
+                            &size,
+                            reinterpret_cast<const Bytef*>( source.data() ),
+                            source.size(),
+                            Z_DEFAULT_COMPRESSION ) != Z_OK;
+        objectStream.compressed.resize( size );
+    }
+
+    bool IsFailed() const { return failed; }
+
+private:
+    ObjectStream & objectStream;
+    bool failed;
+};
+
+std::string Serialize( const PoDoFo::PdfVariant & value )
+// Returns pdf syntax of value
+{
+    std::ostringstream output;
+    {
+        PoDoFo::PdfOutputDevice device( &output );
+        value.Write( &device, PoDoFo::ePdfWriteMode_Compact, NULL );
+        device.Flush();
+    }
+    return output.str();
+}
+
+bool IsCrossReferenceObject( const PoDoFo::PdfObject & object )
+// True for object and xref streams of the source file
+{
+    if ( not object.IsDictionary() ) return false;
+    const PoDoFo::PdfObject* type = object.GetDictionary().GetKey( "Type" );
+    return type != NULL && type->IsName()
+           && ( type->GetName() == PoDoFo::PdfName( "ObjStm" )
+                || type->GetName() == PoDoFo::PdfName( "XRef" ) );
+}
+
+void WriteString( PoDoFo::PdfOutputDevice & outputDevice,
+                  const std::string & data )
+{
+    outputDevice.Write( data.data(), data.size() );
+}
+
+void WriteStreamObject( PoDoFo::PdfOutputDevice & outputDevice,
+                        unsigned long objectNumber,
+                        const std::string & dictionary,
+                        const std::string & data )
+// Writes indirect object with Flate encoded stream data
+{
+    std::ostringstream head;
+    head << objectNumber << " 0 obj\n<<" << dictionary
+         << "/Filter/FlateDecode/Length " << data.size() << ">>\nstream\n";
+    WriteString( outputDevice, head.str() );
+    WriteString( outputDevice, data );
+    WriteString( outputDevice, "\nendstream\nendobj\n" );
+}
+
+int ByteWidth( unsigned long long value )
+// Number of bytes needed for value, at least 1
+{
+    int width = 1;
+    while ( width < 8 && ( value >> ( 8 * width ) ) != 0 ) ++width;
+    return width;
+}
+
+void AppendBigEndian( std::string & data, unsigned long long value,
+                      int width )
+{
+    for ( int i = width - 1; i >= 0; --i )
+        data.push_back( static_cast<char>( ( value >> ( 8 * i ) ) & 0xFF ) );
+}
+
+int GetMinorVersion( const PoDoFo::PdfName & version )
+// Minor number of "1.x" version name, -1 if the name is not such
+{
+    const std::string & name = version.GetName();
+    if ( name.size() != 3 || name[0] != '1' || name[1] != '.'
+         || name[2] < '0' || name[2] > '9' )
+        return -1;
+    return name[2] - '0';
+}
+
+class VersionUpdate
+// Sets catalog /Version, which overrides the header when later, to the
+// version of the output and puts the original name back when destroyed,
+// so that the document is left as it was loaded even if writing fails.
+{
+public:
+    explicit VersionUpdate( PoDoFo::PdfMemDocument & pdfDocument )
+        : catalog( NULL ),
+          minorVersion( std::max( 5, static_cast<int>(
+                                        pdfDocument.GetPdfVersion() ) ) )
+    {
+        PoDoFo::PdfObject* root = pdfDocument.GetCatalog();
+        if ( root == NULL || not root->IsDictionary() ) return;
+        PoDoFo::PdfObject* version = root->GetDictionary().GetKey( "Version" );
+        if ( version == NULL || not version->IsName() ) return;
+
+        minorVersion = std::max( minorVersion,
+                                 GetMinorVersion( version->GetName() ) );
+        const char name[] = { '1', '.', static_cast<char>( '0' + minorVersion ),
+                              '\0' };
+        if ( version->GetName() == PoDoFo::PdfName( name ) ) return;
+        originalVersion = version->GetName();
+        root->GetDictionary().AddKey( "Version", PoDoFo::PdfName( name ) );
+        catalog = root;
+    }
+
+    ~VersionUpdate()
+    {
+        if ( catalog != NULL )
+            catalog->GetDictionary().AddKey( "Version", originalVersion );
+    }
+
+    // Minor number of PDF 1.x version for the output: the version of
+    // the document, but at least 1.5 required by object streams
+    int GetOutputVersion() const { return minorVersion; }
+
+private:
+    // Set only if /Version was changed
+    PoDoFo::PdfObject* catalog;
+    PoDoFo::PdfName originalVersion;
+    int minorVersion;
+
+    VersionUpdate( const VersionUpdate & );
+    VersionUpdate & operator= ( const VersionUpdate & );
+};
+
+} // namespace
+
+unsigned long long WriteCompressed( PoDoFo::PdfMemDocument & pdfDocument,
+                                    PoDoFo::PdfOutputDevice & outputDevice,
+                                    unsigned int threadCount )
+{
+    const PoDoFo::PdfObject* trailer = pdfDocument.GetTrailer();
+    if ( trailer == NULL || trailer->GetDictionary().HasKey( "Encrypt" ) )
+        throw std::runtime_error( "compressed output of encrypted or "
+                                  "empty document is not supported" );
+
+    const unsigned long long start = outputDevice.GetLength();
+    const VersionUpdate versionUpdate( pdfDocument );
+    std::ostringstream header;
+    // Binary comment marks the file as binary for transfer programs
+    header << "%PDF-1." << versionUpdate.GetOutputVersion()
+           << "\n%\xE2\xE3\xCF\xD3\n";
+    WriteString( outputDevice, header.str() );
+
+    /* Objects with streams and objects of non-zero generation can not be
+     * stored in object streams, they are written right away.
+     * The rest is serialized here, since PoDoFo objects can be touched
+     * only by this thread, and compressed later in parallel.
+     */
+    std::vector<XRefEntry> xref( 1, XRefEntry( 0, 0, 65535 ) );
+    std::vector<ObjectStream> objectStreams;
+    PoDoFo::PdfVecObjects & objects = pdfDocument.GetObjects();
+    PoDoFo::TIVecObjects it;
+    for ( it = objects.begin(); it != objects.end(); ++it )
+    {
+        PoDoFo::PdfObject* object = *it;
+        if ( IsCrossReferenceObject( *object ) ) continue;
+        const PoDoFo::PdfReference & reference = object->Reference();
+        if ( xref.size() <= reference.ObjectNumber() )
+            xref.resize( reference.ObjectNumber() + 1 );
+
+        if ( object->HasStream() || reference.GenerationNumber() != 0 )
+        {
+            xref[reference.ObjectNumber()] = XRefEntry(
+                                    1, outputDevice.GetLength() - start,
+                                    reference.GenerationNumber() );
+            object->WriteObject( &outputDevice,
+                                 PoDoFo::ePdfWriteMode_Compact, NULL );
+            continue;
+        }
+
+        if ( objectStreams.empty()
+             || objectStreams.back().objectNumbers.size()
+                    >= OBJECTS_PER_STREAM )
+            objectStreams.push_back( ObjectStream() );
+        ObjectStream & objectStream = objectStreams.back();
+        std::ostringstream headerEntry;
+        headerEntry << reference.ObjectNumber() << " "
+                    << objectStream.data.size() << " ";
+        objectStream.header += headerEntry.str();
+        objectStream.objectNumbers.push_back( reference.ObjectNumber() );
+        objectStream.data += Serialize( *object );
+        objectStream.data += "\n";
+    }
+
+    {
+        std::vector<CompressTask*> tasks;
+        for ( size_t i = 0; i < objectStreams.size(); ++i )
+            tasks.push_back( new CompressTask( objectStreams[i] ) );
+        {
+            WorkerPool pool( std::min<size_t>( threadCount,
+                                               objectStreams.size() ) );
+            for ( size_t i = 0; i < tasks.size(); ++i ) pool.Add( tasks[i] );
+            pool.Wait();
+        }
+        bool failed = false;
+        for ( size_t i = 0; i < tasks.size(); ++i )
+        {
+            if ( tasks[i]->IsFailed() ) failed = true;
+            delete tasks[i];
+        }
+        if ( failed ) throw std::runtime_error( "object stream compression "
+                                                "failed" );
+    }
+
+    // Object streams and xref stream get numbers after the last object
+    unsigned long nextNumber = xref.size();
+    for ( size_t i = 0; i < objectStreams.size(); ++i )
+    {
+        const ObjectStream & objectStream = objectStreams[i];
+        unsigned long streamNumber = nextNumber++;
+        xref.push_back( XRefEntry( 1, outputDevice.GetLength() - start, 0 ) );
+        for ( size_t n = 0; n < objectStream.objectNumbers.size(); ++n )
+            xref[objectStream.objectNumbers[n]] = XRefEntry( 2, streamNumber,
+                                                             n );
+
+        std::ostringstream dictionary;
+        dictionary << "/Type/ObjStm/N " << objectStream.objectNumbers.size()
+                   << "/First " << objectStream.header.size();
+        WriteStreamObject( outputDevice, streamNumber, dictionary.str(),
+                           objectStream.compressed );
+    }
+
+    // Xref stream is the last object and describes itself too
+    unsigned long xrefNumber = nextNumber;
+    unsigned long long xrefOffset = outputDevice.GetLength() - start;
+    xref.push_back( XRefEntry( 1, xrefOffset, 0 ) );
+
+    unsigned long long maxField2 = 0;
+    for ( size_t i = 0; i < xref.size(); ++i )
+        if ( xref[i].field2 > maxField2 ) maxField2 = xref[i].field2;
+    const int field2Width = ByteWidth( maxField2 );
+    std::string xrefData;
+    for ( size_t i = 0; i < xref.size(); ++i )
+    {
+        AppendBigEndian( xrefData, xref[i].type, 1 );
+        AppendBigEndian( xrefData, xref[i].field2, field2Width );
+        AppendBigEndian( xrefData, xref[i].field3, 2 );
+    }
+    std::string compressedXref( compressBound( xrefData.size() ), '\0' );
+    uLongf compressedSize = compressedXref.size();
+    if ( compress2( reinterpret_cast<Bytef*>( &compressedXref[0] ),
+                    &compressedSize,
+                    reinterpret_cast<const Bytef*>( xrefData.data() ),
+                    xrefData.size(), Z_DEFAULT_COMPRESSION ) != Z_OK )
+        throw std::runtime_error( "xref stream compression failed" );
+    compressedXref.resize( compressedSize );
+
+    // Trailer entries become entries of xref stream dictionary
+    std::ostringstream dictionary;
+    dictionary << "/Type/XRef/Size " << xref.size()
+               << "/W[1 " << field2Width << " 2]";
+    const PoDoFo::TKeyMap & trailerKeys = trailer->GetDictionary().GetKeys();
+    PoDoFo::TKeyMap::const_iterator key;
+    for ( key = trailerKeys.begin(); key != trailerKeys.end(); ++key )
+    {
+        if ( key->first == PoDoFo::PdfName( "Root" )
+             || key->first == PoDoFo::PdfName( "Info" )
+             || key->first == PoDoFo::PdfName( "ID" ) )
+            dictionary << "/" << key->first.GetEscapedName()
+                       << Serialize( *key->second );
+    }
+    WriteStreamObject( outputDevice, xrefNumber, dictionary.str(),
+                       compressedXref );
+
+    std::ostringstream tail;
+    tail << "startxref\n" << xrefOffset << "\n%%EOF\n";
+    WriteString( outputDevice, tail.str() );
+    outputDevice.Flush();
+    return outputDevice.GetLength() - start;
+}
@@ -0,0 +1,37 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef OBJECT_STREAM_WRITER_H
+#define OBJECT_STREAM_WRITER_H
+
+#include <podofo/podofo.h>
+
+// Writes pdfDocument as PDF 1.5 or later file: objects without streams are
+// packed into Flate compressed object streams and cross-reference table is
+// written as compressed xref stream (see Pdf Reference, ch. 3.4.6, 3.4.7).
+// Version of the document is kept if later than 1.5, catalog /Version
+// is written to match the header and put back in pdfDocument afterwards.
+// Object streams are compressed on threadCount threads.
+// Returns number of bytes written. Encrypted documents are not supported.
+unsigned long long WriteCompressed( PoDoFo::PdfMemDocument & pdfDocument,
+                                    PoDoFo::PdfOutputDevice & outputDevice,
+                                    unsigned int threadCount );
+
+#endif // OBJECT_STREAM_WRITER_H
@@ -22,13 +22,33 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <map>
+#include <set>
+// Directory walk for --inventory
+#include <dirent.h>
+#include <sys/stat.h>
 
 // Include all podofo header files
 #include <podofo/podofo.h>
 //Include command line options parser
 #include "getopt_pp.h"
-
-const PoDoFo::PdfName NONE_COLOR("None");
+// Thread pool for batch processing
+#include "worker-pool.h"
+// Raw bytes pre-scan for files without spots
+#include "raw-scan.h"
+// Matching of spot names against the given list
+#include "spot-matcher.h"
+// Counters and timers for --stats
+#include "run-stats.h"
+// Spot listing and disabling core, also built as libpdfspot
+#include "spot-disabler.h"
+// Unix domain socket daemon
+#include "spot-server.h"
+// Results of earlier runs for --cache
+#include "result-cache.h"
 
 void PrintHelpMessage()
 {
@@ -42,14 +62,75 @@ void PrintHelpMessage()
     std::cout << "  pdf-spot-disabler in.pdf [out.pdf] [-options]"
               << " [SpotName1 SpotName2 ... SpotNameN]"
               << std::endl;
+    std::cout << "  pdf-spot-disabler -b manifest [-options]"
+              << " [SpotName1 SpotName2 ... SpotNameN]"
+              << std::endl;
+    std::cout << "  pdf-spot-disabler in.pdf -v variants [-options]"
+              << std::endl;
+    std::cout << "  pdf-spot-disabler --serve socket [-options]"
+              << std::endl;
+    std::cout << "  pdf-spot-disabler --inventory dir|list [-options]"
+              << std::endl;
     std::cout << std::endl;
     std::cout << "Valid options are:"
               << std::endl;
     std::cout << "  -l, --list   lists spots of in.pdf that can be disabled."
               << std::endl;
+    std::cout << "  --report json|csv   lists every spot of in.pdf once"
+              << " with its alternate color space, number of color spaces"
+              << " naming it and pages using it. Implies -l."
+              << std::endl;
+    std::cout << "  -i, --incremental   keeps the original bytes of in.pdf"
+              << " and appends only changed objects to out.pdf."
+              << " Untouched objects and streams are never rewritten."
+              << std::endl;
+    std::cout << "  -z, --compress   writes out.pdf as PDF 1.5 or later with"
+              << " compressed object streams and xref stream."
+              << " Ignored with -i."
+              << std::endl;
+    std::cout << "  -b, --batch manifest   processes every"
+              << " \"in.pdf<TAB>out.pdf\" line of manifest file"
+              << " (\"-\" reads it from stdin)."
+              << std::endl;
+    std::cout << "  --inventory dir|list   scans every pdf file of directory"
+              << " dir and its subdirectories, or every file named by a line"
+              << " of list file (\"-\" reads it from stdin), and prints"
+              << " each spot found once with the number of files using it."
+              << std::endl;
+    std::cout << "  -j, --jobs N   number of files processed at once"
+              << " in batch and inventory modes, or of threads scanning pages"
+              << " and compressing one file"
+              << " (default: number of processors)."
+              << std::endl;
+    std::cout << "  -v, --variants list   loads in.pdf once and writes"
+              << " every \"out.pdf<TAB>SpotName1<TAB>...\" line of list file"
+              << " (\"-\" reads it from stdin)."
+              << std::endl;
+    std::cout << "  --serve socket   keeps running and answers"
+              << " \"list<TAB>in.pdf\" and"
+              << " \"disable<TAB>in.pdf<TAB>out.pdf<TAB>SpotName1<TAB>...\""
+              << " request lines on Unix domain socket with JSON lines,"
+              << " serving up to -j connections at once."
+              << " Stops on SIGINT or SIGTERM."
+              << std::endl;
+    std::cout << "  --cache dir   reuses outputs and spot lists of"
+              << " earlier runs on the same in.pdf contents with the same"
+              << " spot names and options, keeping them in directory dir."
+              << std::endl;
+    std::cout << "  --cache-size MB   size limit of --cache directory,"
+              << " the least recently used results are removed over it"
+              << " (default: 1024)."
+              << std::endl;
+    std::cout << "  -s, --stats   prints phase times and counters as JSON"
+              << " to stderr."
+              << std::endl;
     std::cout << "  -h, --help   prints this message"
               << std::endl;
     std::cout << std::endl;
+    std::cout << "File name \"-\" in place of in.pdf or out.pdf"
+              << " reads pdf from stdin or writes it to stdout."
+              << std::endl;
+    std::cout << std::endl;
     std::cout << "If the only in.pdf file name specified lists all available"
               << " spots, just like -l option."
               << std::endl;          
@@ -71,100 +152,6 @@ void PrintHelpMessage()
     std::cout << std::endl;
 }
 
-std::vector<PoDoFo::PdfReference> GetColorReferences( 
-                                    const PoDoFo::PdfMemDocument & pdfDocument )
-// Returns a vector with references to color decryption arrays in pdf document
-{
-    //Initialize references vector being returned by this function
-    std::vector<PoDoFo::PdfReference> colorReferences;
-    
-    // Iterate over each page of pdf document
-    for ( int pn = 0; pn < pdfDocument.GetPageCount(); ++pn ) 
-    {
-        PoDoFo::PdfPage* page = pdfDocument.GetPage(pn);
-        // Get the Resource dictionary of the current page:
-        PoDoFo::PdfObject* pageResources = (*page).GetResources();
-        // If something wrong with this page - just continue with next
-        if ( pageResources == NULL ) continue; 
-        // Get the ColorSpace subdictionary
-        if( (*pageResources).IsDictionary()
-            && (*pageResources).GetDictionary().HasKey("ColorSpace") 
-            && (*pageResources).GetDictionary().GetKey("ColorSpace")
-                                               ->IsDictionary() )
-        {
-            PoDoFo::PdfDictionary colorSpace = (*pageResources)
-                                               .GetDictionary()
-                                               .GetKey("ColorSpace")
-                                               ->GetDictionary();
-            /* The ColorSpace subdictionary entries are like "Name : Reference".
-            * "Name" is something like CS11, CS24 and "Reference" points
-            * to array with actual values of color entry.
-            */ 
-            PoDoFo::TKeyMap::iterator it = colorSpace.GetKeys().begin();
-            // Go through all entries of the ColorSpace subdictionary
-            while( it != colorSpace.GetKeys().end() )
-            {
-                // Obtaining color array by reference
-                if ( (*it).second->IsReference() )
-                {
-                    PoDoFo::PdfReference ref = (*it).second->GetReference();
-                    //Check reference vector for duplicates
-                    if ( std::count(colorReferences.begin(),
-                                    colorReferences.end(),
-                                    ref) == 0 )
-                    {
-                        // If current reference is unique, add it to the vector
-                        colorReferences.push_back( ref );
-                    }
-                }
-                ++it;
-            } // ColorSpace subdictionary iterator
-        } // ColorSpace subdictionary processing
-    } // Current Page processing
-
-    return colorReferences;
-}
-
-std::string CreateSpaces ( std::string & name )
-// Converts #20 sequences to spaces
-{
-  std::string nameWithSpaces(name);
-  while ( nameWithSpaces.find("#20") != std::string::npos )
-      nameWithSpaces.replace ( nameWithSpaces.find("#20"), 3, " " );
-  return nameWithSpaces;
-}
-
-void ListAvailableSpots( const PoDoFo::PdfMemDocument & pdfDocument,
-                         std::vector<PoDoFo::PdfReference> colorReferences )
-// Prints pdf document spot names to std::cout
-{
-    std::vector<PoDoFo::PdfReference>::iterator it = colorReferences.begin();
-    while ( it != colorReferences.end() )
-    {
-        // Obtaining color array by reference
-        if ( pdfDocument.GetObjects().GetObject(*it)->IsArray() )
-        {
-            PoDoFo::PdfArray colorArray = pdfDocument.GetObjects()
-                                                     .GetObject(*it)
-                                                     ->GetArray();
-            /* Color array for separation colorspace has 4 entries: 
-            *[ /Separation spotName alternateSpace tintTransform ]
-            */
-            if ( colorArray.GetSize() > 1
-                 && colorArray[0].IsName()
-                 && colorArray[0].GetName().GetEscapedName() == "Separation"
-                 && colorArray[1].IsName() )
-            {
-                std::string spotName = colorArray[1].GetName().GetEscapedName();
-                /* In pdf's spot names spaces are replaced with "#20".
-                 * So, replacing them back
-                 */
-                std::cout << CreateSpaces(spotName) << std::endl;
-            }
-        }
-        ++it;
-    } // Iterating through color references
-}
 bool IsPdfFileName(const std::string name)
 // True if given string is pdf file name
 {
@@ -176,44 +163,993 @@ bool IsPdfFileName(const std::string name)
              && name[len-4] == '.' );
 }
 
+bool IsPdfFileArgument( const std::string & name )
+// True if given string is pdf file name or "-" meaning stdin or stdout
+{
+    return name == "-" || IsPdfFileName( name );
+}
 
 bool IsProgramOptionsValid( const std::vector<std::string> programOptions )
 // Checks if provided command line options are valid
 {
     if ( programOptions.size() < 1 ) return false;
     if ( programOptions.size() < 2
-         && IsPdfFileName(programOptions[0]) ) return true;
+         && IsPdfFileArgument(programOptions[0]) ) return true;
     if ( programOptions.size() > 1 
-         && IsPdfFileName(programOptions[0])
-         && IsPdfFileName(programOptions[1]) ) return true;
+         && IsPdfFileArgument(programOptions[0])
+         && IsPdfFileArgument(programOptions[1]) ) return true;
 
     return false;
 }
 
-bool MustBeDisabled( std::string rawSpotName,
-                     std::vector<std::string> & spotsToDisable )
-// Checks if spot rawSpotName must be disabled according to spotsToDisable list
+std::vector<std::string> GetSpotsToDisable(
+                            const std::vector<std::string> & programOptions )
+// Returns normalized vector of spot names given in command line
 {
-    // When given spot list is empty, disable all spots
-    if ( spotsToDisable.size() < 1 ) return true;
-
-    std::string spotName;
-    // Change %20 sequences to spaces
-    spotName = CreateSpaces(rawSpotName);
-    // Convert spotName to lowercase
-    std::transform(spotName.begin(), spotName.end(),
-                   spotName.begin(), ::tolower);
-    // Iterate through spotsToDisable
-    std::vector<std::string>::iterator it = spotsToDisable.begin();
-    while ( it != spotsToDisable.end() )
-    {
-        // Check if rawSpotName contains current item from spotsToDisable list
-        if ( spotName.find(*it) != std::string::npos ) return true;
-        ++it;
+    std::vector<std::string> spotsToDisable;
+    std::string temporarySpotName;
+    std::vector<std::string>::const_iterator iter = programOptions.begin();
+    while ( iter != programOptions.end() )
+    {
+        if ( not IsPdfFileArgument(*iter) )
+        {
+            temporarySpotName = *iter;
+            // Convert SpotName to lowercase
+            std::transform(temporarySpotName.begin(), temporarySpotName.end(),
+                   temporarySpotName.begin(), ::tolower);
+            // Add temporarySpotName to the list of spots being disabled
+            spotsToDisable.push_back(temporarySpotName);
+        }
+        ++iter;
     }
-    return false;
+    return spotsToDisable;
+}
+
+std::string ReadStdin()
+// Returns whole contents of stdin
+{
+    std::string data;
+    char buffer[1 << 16];
+    while ( std::cin.read( buffer, sizeof(buffer) ) || std::cin.gcount() > 0 )
+        data.append( buffer, std::cin.gcount() );
+    return data;
+}
+
+class PdfInput
+// Source pdf file. Name "-" stands for stdin, which is read into memory,
+// because parser needs random access to the data.
+{
+public:
+    explicit PdfInput( const std::string & fileName )
+        : fileName( fileName ),
+          fromStdin( fileName == "-" ),
+          data( fromStdin ? ReadStdin() : std::string() ),
+          dataBuffer( data.data(), data.size() ),
+          dataStream( &dataBuffer )
+    {}
+
+    const std::string & GetName() const { return fileName; }
+
+    unsigned long long GetSize() const
+    {
+        return fromStdin ? data.size() : GetFileSize( fileName.c_str() );
+    }
+
+    bool MayContainSpots() const
+    {
+        return fromStdin ? ::MayContainSpots( data.data(), data.size() )
+                         : ::MayContainSpots( fileName );
+    }
+
+    // Writes input as is to outputFileName, "-" is stdout
+    bool CopyTo( const std::string & outputFileName ) const
+    {
+        // Raw write to stdout must follow already buffered output
+        std::cout.flush();
+        return fromStdin ? WritePdfData( data.data(), data.size(),
+                                         outputFileName )
+                         : CopyPdfFile( fileName, outputFileName );
+    }
+
+    // Key of input contents with parameters in resultCache
+    std::string GetCacheKey( const ResultCache & resultCache,
+                             const std::string & parameters ) const
+    {
+        return fromStdin ? resultCache.GetKey( data.data(), data.size(),
+                                               parameters )
+                         : resultCache.GetKey( fileName, parameters );
+    }
+
+    // Where page scanning threads load their document copies from
+    PdfSource GetSource() const
+    {
+        return fromStdin ? PdfSource( data.data(), data.size() )
+                         : PdfSource( fileName );
+    }
+
+    // Contents of stdin are parsed in place, not copied by PoDoFo,
+    // so only one document at a time may be loaded from stdin input
+    void Load( PoDoFo::PdfMemDocument & pdfDocument ) const
+    {
+        if ( fromStdin )
+        {
+            dataStream.clear();
+            dataStream.seekg( 0 );
+            pdfDocument.Load( PoDoFo::PdfRefCountedInputDevice(
+                            new PoDoFo::PdfInputDevice( &dataStream ) ) );
+        }
+        else
+            pdfDocument.Load( fileName.c_str() );
+    }
+
+private:
+    std::string fileName;
+    bool fromStdin;
+    // Contents of stdin
+    std::string data;
+    // Parser reads data through these until the document is destroyed
+    mutable MemoryStreamBuffer dataBuffer;
+    mutable std::istream dataStream;
+};
+
+bool MustBeParsed( const PdfInput & input,
+                   const OutputOptions & outputOptions )
+// False if input can be copied to the output as is
+{
+    // Compressed output differs from the input even without spots
+    if ( outputOptions.compressed && not outputOptions.incremental )
+        return true;
+    return input.MayContainSpots();
+}
+
+unsigned long long SaveDocument( PoDoFo::PdfMemDocument & pdfDocument,
+                            const PdfInput & input,
+                            const std::vector<DisabledSpot> & disabledSpots,
+                            const std::string & outputFileName,
+                            const OutputOptions & outputOptions )
+// Writes pdf document loaded from input to outputFileName, "-" is stdout.
+// Returns number of bytes written.
+{
+    std::auto_ptr<PoDoFo::PdfOutputDevice> outputDevice(
+        outputFileName == "-"
+            ? new PoDoFo::PdfOutputDevice( &std::cout )
+            : new PoDoFo::PdfOutputDevice( outputFileName.c_str() ) );
+    return WriteDocument( pdfDocument, input.GetSource(), disabledSpots,
+                          *outputDevice, outputOptions );
+}
+
+bool DisableSpotsInFile( const std::string & inputFileName,
+                         const std::string & outputFileName,
+                         SpotDecisions & spotsToDisable,
+                         const OutputOptions & outputOptions,
+                         RunStats & stats,
+                         ResultCache* resultCache = NULL,
+                         const std::string & cacheParameters = std::string() )
+// Loads inputFileName, disables spots and saves result to outputFileName.
+// Returns false if inputFileName has no spots and was copied as is.
+// Result is taken from resultCache if given and stored there otherwise,
+// cacheParameters must describe spotsToDisable and outputOptions.
+{
+    ++stats.files;
+    const PdfInput input( inputFileName );
+    stats.inputBytes += input.GetSize();
+    bool mayContainSpots;
+    {
+        PhaseTimer timer( stats, RunStats::PHASE_PRESCAN );
+        // Most files have no spot colors at all, parsing them is a waste
+        mayContainSpots = MustBeParsed( input, outputOptions )
+                          || not input.CopyTo( outputFileName );
+    }
+    if ( not mayContainSpots )
+    {
+        ++stats.filesCopied;
+        stats.outputBytes += input.GetSize();
+        return false;
+    }
+    std::string cacheKey;
+    if ( resultCache != NULL )
+    {
+        PhaseTimer timer( stats, RunStats::PHASE_PRESCAN );
+        cacheKey = input.GetCacheKey( *resultCache, cacheParameters );
+        // Raw write to stdout must follow already buffered output
+        std::cout.flush();
+        if ( not cacheKey.empty()
+             && resultCache->Fetch( cacheKey, outputFileName ) )
+        {
+            if ( outputFileName != "-" )
+                stats.outputBytes += GetFileSize( outputFileName.c_str() );
+            return true;
+        }
+    }
+
+    PoDoFo::PdfMemDocument pdfDoc;
+    {
+        PhaseTimer timer( stats, RunStats::PHASE_LOAD );
+        /* PoDoFo parses the file with load on demand: only the xref table
+         * is read here, objects and streams are parsed when dereferenced.
+         */
+        input.Load( pdfDoc );
+    }
+    std::vector<ColorReference> colorReferences;
+    {
+        PhaseTimer timer( stats, RunStats::PHASE_SCAN );
+        colorReferences = GetColorReferences( pdfDoc, input.GetSource(),
+                                              outputOptions.threadCount );
+        stats.pages += pdfDoc.GetPageCount();
+        stats.colorReferences += colorReferences.size();
+    }
+    std::vector<DisabledSpot> disabledSpots;
+    {
+        PhaseTimer timer( stats, RunStats::PHASE_REWRITE );
+        DisableSpots( pdfDoc, colorReferences, spotsToDisable, stats,
+                      disabledSpots );
+    }
+    {
+        PhaseTimer timer( stats, RunStats::PHASE_WRITE );
+        stats.outputBytes += SaveDocument( pdfDoc, input, disabledSpots,
+                                           outputFileName, outputOptions );
+    }
+    // Data written to stdout can not be read back
+    if ( not cacheKey.empty() && outputFileName != "-" )
+        resultCache->Store( cacheKey, outputFileName );
+    return true;
+}
+
+std::string GetCacheParameters( const std::vector<std::string> & spotNames,
+                                const OutputOptions & outputOptions )
+// Everything but input contents the result of disabling depends on.
+// Names are lowercase already, their order and repeats do not matter.
+{
+    const std::set<std::string> names( spotNames.begin(), spotNames.end() );
+    std::ostringstream parameters;
+    parameters << "disable" << '\0' << outputOptions.incremental
+               << outputOptions.compressed;
+    std::set<std::string>::const_iterator it;
+    for ( it = names.begin(); it != names.end(); ++it )
+        parameters << '\0' << *it;
+    return parameters.str();
+}
+
+// Parameters of --list results in the cache
+const char* const LIST_CACHE_PARAMETERS = "list";
+
+std::vector<std::string> ListSpotsInFile( const std::string & inputFileName,
+                                          unsigned int threadCount,
+                                          RunStats & stats,
+                                          ResultCache* resultCache = NULL )
+// Loads inputFileName and returns its spot names.
+// Names are taken from resultCache if given and stored there otherwise.
+{
+    ++stats.files;
+    const PdfInput input( inputFileName );
+    stats.inputBytes += input.GetSize();
+    std::string cacheKey;
+    {
+        PhaseTimer timer( stats, RunStats::PHASE_PRESCAN );
+        if ( not input.MayContainSpots() ) return std::vector<std::string>();
+        if ( resultCache != NULL )
+            cacheKey = input.GetCacheKey( *resultCache,
+                                          LIST_CACHE_PARAMETERS );
+        std::string cachedNames;
+        if ( not cacheKey.empty()
+             && resultCache->FetchData( cacheKey, cachedNames ) )
+        {
+            // Names may contain any character but zero
+            std::vector<std::string> spotNames;
+            std::istringstream names( cachedNames );
+            std::string name;
+            while ( std::getline( names, name, '\0' ) )
+                spotNames.push_back( name );
+            return spotNames;
+        }
+    }
+    PoDoFo::PdfMemDocument pdfDoc;
+    {
+        PhaseTimer timer( stats, RunStats::PHASE_LOAD );
+        input.Load( pdfDoc );
+    }
+    /* Listing dereferences only the page tree, resource dictionaries
+     * and color arrays, so content and image streams are never read.
+     */
+    PhaseTimer timer( stats, RunStats::PHASE_SCAN );
+    std::vector<ColorReference> colorReferences
+                = GetColorReferences( pdfDoc, input.GetSource(), threadCount );
+    stats.pages += pdfDoc.GetPageCount();
+    stats.colorReferences += colorReferences.size();
+    const std::vector<std::string> spotNames
+                    = ListAvailableSpots( pdfDoc, colorReferences, stats );
+    if ( not cacheKey.empty() )
+    {
+        std::string names;
+        for ( size_t i = 0; i < spotNames.size(); ++i )
+            names += spotNames[i] + '\0';
+        resultCache->StoreData( cacheKey, names );
+    }
+    return spotNames;
+}
+
+std::vector<SpotUsage> GetSpotUsageInFile( const std::string & inputFileName,
+                                           unsigned int threadCount,
+                                           RunStats & stats )
+// Loads inputFileName and returns usage of its spots
+{
+    ++stats.files;
+    const PdfInput input( inputFileName );
+    stats.inputBytes += input.GetSize();
+    PoDoFo::PdfMemDocument pdfDoc;
+    {
+        PhaseTimer timer( stats, RunStats::PHASE_LOAD );
+        input.Load( pdfDoc );
+    }
+    // Pages are noted by the same walk which finds color arrays
+    PhaseTimer timer( stats, RunStats::PHASE_SCAN );
+    std::vector< std::vector<int> > referencePages;
+    std::vector<ColorReference> colorReferences
+                = GetColorReferences( pdfDoc, input.GetSource(), threadCount,
+                                      &referencePages );
+    stats.pages += pdfDoc.GetPageCount();
+    stats.colorReferences += colorReferences.size();
+    return GetSpotUsage( pdfDoc, colorReferences, referencePages, stats );
+}
+
+std::string CsvString( const std::string & value )
+// Quotes value as CSV field
+{
+    std::string result = "\"";
+    for ( size_t i = 0; i < value.size(); ++i )
+    {
+        if ( value[i] == '"' ) result += '"';
+        result += value[i];
+    }
+    return result + '"';
+}
+
+void PrintSpotReport( std::ostream & output,
+                      const std::vector<SpotUsage> & spots,
+                      const std::string & format )
+// Prints spots as one JSON object or as CSV table with header
+{
+    if ( format == "csv" )
+    {
+        output << "name,alternate,color_spaces,pages" << std::endl;
+        for ( size_t i = 0; i < spots.size(); ++i )
+        {
+            output << CsvString( spots[i].name ) << ','
+                   << CsvString( spots[i].alternateSpace ) << ','
+                   << spots[i].colorSpaceCount << ',';
+            // Page numbers are space separated to stay one field
+            for ( size_t j = 0; j < spots[i].pages.size(); ++j )
+                output << ( j > 0 ? " " : "" ) << spots[i].pages[j];
+            output << std::endl;
+        }
+        return;
+    }
+    output << "{\"spots\":[";
+    for ( size_t i = 0; i < spots.size(); ++i )
+    {
+        output << ( i > 0 ? "," : "" )
+               << "{\"name\":" << JsonString( spots[i].name )
+               << ",\"alternate\":" << JsonString( spots[i].alternateSpace )
+               << ",\"color_spaces\":" << spots[i].colorSpaceCount
+               << ",\"pages\":[";
+        for ( size_t j = 0; j < spots[i].pages.size(); ++j )
+            output << ( j > 0 ? "," : "" ) << spots[i].pages[j];
+        output << "]}";
+    }
+    output << "]}" << std::endl;
+}
+
+class BatchJob : public WorkerTask
+// Processing of one input/output pair from batch manifest
+{
+public:
+    BatchJob( const std::string & inputFileName,
+              const std::string & outputFileName,
+              SpotDecisions & spotsToDisable,
+              const OutputOptions & outputOptions,
+              ResultCache* resultCache,
+              const std::string & cacheParameters,
+              pthread_mutex_t & outputMutex )
+        : inputFileName( inputFileName ),
+          outputFileName( outputFileName ),
+          spotsToDisable( spotsToDisable ),
+          outputOptions( outputOptions ),
+          resultCache( resultCache ),
+          cacheParameters( cacheParameters ),
+          outputMutex( outputMutex ),
+          succeeded( false ),
+          copied( false )
+    {}
+
+    void Run()
+    {
+        std::string errorMessage;
+        // Any failure is reported and does not stop other jobs
+        try
+        {
+            copied = not DisableSpotsInFile( inputFileName, outputFileName,
+                                             spotsToDisable, outputOptions,
+                                             stats, resultCache,
+                                             cacheParameters );
+            succeeded = true;
+        }
+        catch ( const PoDoFo::PdfError & error )
+        {
+            errorMessage = error.what();
+        }
+        catch ( const std::exception & error )
+        {
+            errorMessage = error.what();
+        }
+        catch ( ... )
+        {
+            errorMessage = "unknown error";
+        }
+
+        MutexLock lock( outputMutex );
+        if ( succeeded && copied )
+            std::cout << "COPIED\t" << inputFileName << "\t" << outputFileName
+                      << std::endl;
+        else if ( succeeded )
+            std::cout << "OK\t" << inputFileName << "\t" << outputFileName
+                      << std::endl;
+        else
+            std::cout << "FAILED\t" << inputFileName << "\t" << errorMessage
+                      << std::endl;
+    }
+
+    bool IsSucceeded() const { return succeeded; }
+    // True if file had no spots and was copied without parsing
+    bool IsCopied() const { return copied; }
+    const RunStats & GetStats() const { return stats; }
+
+private:
+    std::string inputFileName;
+    std::string outputFileName;
+    SpotDecisions & spotsToDisable;
+    const OutputOptions & outputOptions;
+    ResultCache* resultCache;
+    const std::string & cacheParameters;
+    pthread_mutex_t & outputMutex;
+    bool succeeded;
+    bool copied;
+    RunStats stats;
+};
+
+bool ReadBatchManifest( std::istream & manifest,
+                   std::vector< std::pair<std::string, std::string> > & files )
+// Reads "in.pdf<TAB>out.pdf" lines. Empty lines and lines starting
+// with '#' are skipped. Returns false if some line is malformed
+// or names stdin or stdout "-".
+{
+    std::string line;
+    while ( std::getline( manifest, line ) )
+    {
+        // Tolerate manifests with DOS line ends
+        if ( not line.empty() && line[line.size() - 1] == '\r' )
+            line.erase( line.size() - 1 );
+        if ( line.empty() || line[0] == '#' ) continue;
+
+        size_t tab = line.find('\t');
+        // Jobs share stdin and stdout, so neither may be a job's file
+        if ( tab == std::string::npos || tab == 0 || tab + 1 == line.size()
+             || line.compare( 0, tab, "-" ) == 0
+             || line.compare( tab + 1, std::string::npos, "-" ) == 0 )
+        {
+            std::cout << "Invalid batch manifest line: " << line << std::endl;
+            return false;
+        }
+        files.push_back( std::make_pair( line.substr( 0, tab ),
+                                         line.substr( tab + 1 ) ) );
+    }
+    return true;
+}
+
+int RunBatch( const std::string & manifestFileName,
+              SpotDecisions & spotsToDisable,
+              const OutputOptions & outputOptions,
+              ResultCache* resultCache,
+              const std::string & cacheParameters,
+              unsigned int jobCount,
+              RunStats & stats )
+// Processes all files listed in manifest on a pool of jobCount threads.
+// Returns program exit code.
+{
+    std::vector< std::pair<std::string, std::string> > files;
+    bool manifestValid;
+    if ( manifestFileName == "-" )
+    {
+        manifestValid = ReadBatchManifest( std::cin, files );
+    }
+    else
+    {
+        std::ifstream manifest( manifestFileName.c_str() );
+        if ( not manifest )
+        {
+            std::cout << "Can not open batch manifest " << manifestFileName
+                      << std::endl;
+            return 1;
+        }
+        manifestValid = ReadBatchManifest( manifest, files );
+    }
+    if ( not manifestValid ) return 1;
+
+    pthread_mutex_t outputMutex;
+    pthread_mutex_init( &outputMutex, NULL );
+
+    // Files are processed in parallel already
+    OutputOptions jobOutputOptions = outputOptions;
+    jobOutputOptions.threadCount = 1;
+    // Every job loads its own PdfMemDocument
+    std::vector<BatchJob*> jobs;
+    for ( size_t i = 0; i < files.size(); ++i )
+        jobs.push_back( new BatchJob( files[i].first, files[i].second,
+                                      spotsToDisable, jobOutputOptions,
+                                      resultCache, cacheParameters,
+                                      outputMutex ) );
+    {
+        WorkerPool pool( std::min<size_t>( jobCount, files.size() ) );
+        for ( size_t i = 0; i < jobs.size(); ++i )
+            pool.Add( jobs[i] );
+        pool.Wait();
+    }
+
+    size_t failedCount = 0;
+    size_t copiedCount = 0;
+    for ( size_t i = 0; i < jobs.size(); ++i )
+    {
+        if ( not jobs[i]->IsSucceeded() ) ++failedCount;
+        if ( jobs[i]->IsCopied() ) ++copiedCount;
+        stats.Add( jobs[i]->GetStats() );
+        delete jobs[i];
+    }
+    pthread_mutex_destroy( &outputMutex );
+
+    std::cout << "Processed " << files.size() << " files: "
+              << files.size() - failedCount << " succeeded, "
+              << failedCount << " failed, "
+              << copiedCount << " copied without spots." << std::endl;
+    return failedCount > 0 ? 1 : 0;
+}
+
+class InventoryJob : public WorkerTask
+// Listing of spots of one file for the inventory
+{
+public:
+    InventoryJob( const std::string & inputFileName,
+                  ResultCache* resultCache,
+                  pthread_mutex_t & outputMutex )
+        : inputFileName( inputFileName ),
+          resultCache( resultCache ),
+          outputMutex( outputMutex ),
+          succeeded( false )
+    {}
+
+    void Run()
+    {
+        std::string errorMessage;
+        try
+        {
+            // Files are scanned in parallel, so pages are not
+            const std::vector<std::string> spotNames
+                            = ListSpotsInFile( inputFileName, 1, stats,
+                                               resultCache );
+            // Arrays of one file may repeat a spot
+            spots.insert( spotNames.begin(), spotNames.end() );
+            succeeded = true;
+        }
+        catch ( const PoDoFo::PdfError & error )
+        {
+            errorMessage = error.what();
+        }
+        catch ( const std::exception & error )
+        {
+            errorMessage = error.what();
+        }
+        catch ( ... )
+        {
+            errorMessage = "unknown error";
+        }
+
+        if ( succeeded ) return;
+        MutexLock lock( outputMutex );
+        std::cout << "FAILED\t" << inputFileName << "\t" << errorMessage
+                  << std::endl;
+    }
+
+    bool IsSucceeded() const { return succeeded; }
+    const std::set<std::string> & GetSpots() const { return spots; }
+    const RunStats & GetStats() const { return stats; }
+
+private:
+    std::string inputFileName;
+    ResultCache* resultCache;
+    pthread_mutex_t & outputMutex;
+    bool succeeded;
+    std::set<std::string> spots;
+    RunStats stats;
+};
+
+bool ReadFileList( std::istream & fileList, std::vector<std::string> & files )
+// Reads one file name per line. Empty lines and lines starting
+// with '#' are skipped. Returns false if some line names stdin "-".
+{
+    std::string line;
+    while ( std::getline( fileList, line ) )
+    {
+        // Tolerate lists with DOS line ends
+        if ( not line.empty() && line[line.size() - 1] == '\r' )
+            line.erase( line.size() - 1 );
+        if ( line.empty() || line[0] == '#' ) continue;
+        // List itself may be stdin, files are read by many jobs at once
+        if ( line == "-" )
+        {
+            std::cout << "Invalid file list line: " << line << std::endl;
+            return false;
+        }
+        files.push_back( line );
+    }
+    return true;
+}
+
+bool HasPdfExtension( const std::string & name )
+// True if name ends with ".pdf" in any case, like scanner output "A.PDF"
+{
+    const std::string EXTENSION = ".pdf";
+    if ( name.size() <= EXTENSION.size() ) return false;
+    const size_t start = name.size() - EXTENSION.size();
+    for ( size_t i = 0; i < EXTENSION.size(); ++i )
+    {
+        if ( ::tolower( static_cast<unsigned char>( name[start + i] ) )
+             != EXTENSION[i] )
+            return false;
+    }
+    return true;
 }
 
+bool FindPdfFiles( const std::string & directoryName,
+                   std::vector<std::string> & files )
+// Adds pdf files of directoryName and its subdirectories to files,
+// the extension is matched ignoring case. Symbolic links to directories
+// are not followed to avoid cycles.
+{
+    DIR* directory = opendir( directoryName.c_str() );
+    if ( directory == NULL ) return false;
+    std::vector<std::string> subdirectories;
+    while ( struct dirent* entry = readdir( directory ) )
+    {
+        const std::string name = entry->d_name;
+        if ( name == "." || name == ".." ) continue;
+        const std::string path = directoryName + "/" + name;
+        struct stat status;
+        if ( lstat( path.c_str(), &status ) != 0 ) continue;
+        if ( S_ISDIR( status.st_mode ) )
+            subdirectories.push_back( path );
+        else if ( HasPdfExtension( name )
+                  && stat( path.c_str(), &status ) == 0
+                  && S_ISREG( status.st_mode ) )
+            files.push_back( path );
+    }
+    closedir( directory );
+    for ( size_t i = 0; i < subdirectories.size(); ++i )
+        FindPdfFiles( subdirectories[i], files );
+    return true;
+}
+
+int RunInventory( const std::string & location,
+                  ResultCache* resultCache,
+                  unsigned int jobCount,
+                  RunStats & stats )
+// Lists spots of all files of location, directory or file list,
+// on a pool of jobCount threads and prints their union.
+// Returns program exit code.
+{
+    std::vector<std::string> files;
+    struct stat status;
+    if ( location == "-" )
+    {
+        if ( not ReadFileList( std::cin, files ) ) return 1;
+    }
+    else if ( stat( location.c_str(), &status ) == 0
+              && S_ISDIR( status.st_mode ) )
+    {
+        if ( not FindPdfFiles( location, files ) )
+        {
+            std::cout << "Can not read directory " << location << std::endl;
+            return 1;
+        }
+        // Directory order depends on the filesystem
+        std::sort( files.begin(), files.end() );
+    }
+    else
+    {
+        std::ifstream fileList( location.c_str() );
+        if ( not fileList )
+        {
+            std::cout << "Can not open file list " << location << std::endl;
+            return 1;
+        }
+        if ( not ReadFileList( fileList, files ) ) return 1;
+    }
+
+    pthread_mutex_t outputMutex;
+    pthread_mutex_init( &outputMutex, NULL );
+    std::vector<InventoryJob*> jobs;
+    for ( size_t i = 0; i < files.size(); ++i )
+        jobs.push_back( new InventoryJob( files[i], resultCache,
+                                          outputMutex ) );
+    {
+        WorkerPool pool( std::min<size_t>( jobCount, files.size() ) );
+        for ( size_t i = 0; i < jobs.size(); ++i )
+            pool.Add( jobs[i] );
+        pool.Wait();
+    }
+
+    // Number of files using every spot, ordered by spot name
+    std::map<std::string, size_t> inventory;
+    size_t failedCount = 0;
+    size_t spottedCount = 0;
+    for ( size_t i = 0; i < jobs.size(); ++i )
+    {
+        if ( not jobs[i]->IsSucceeded() ) ++failedCount;
+        const std::set<std::string> & spots = jobs[i]->GetSpots();
+        if ( not spots.empty() ) ++spottedCount;
+        std::set<std::string>::const_iterator it;
+        for ( it = spots.begin(); it != spots.end(); ++it )
+            ++inventory[*it];
+        stats.Add( jobs[i]->GetStats() );
+        delete jobs[i];
+    }
+    pthread_mutex_destroy( &outputMutex );
+
+    std::map<std::string, size_t>::const_iterator it;
+    for ( it = inventory.begin(); it != inventory.end(); ++it )
+        std::cout << it->second << "\t" << it->first << std::endl;
+    std::cout << "Scanned " << files.size() << " files: "
+              << spottedCount << " with spots, "
+              << failedCount << " failed, "
+              << inventory.size() << " distinct spots." << std::endl;
+    return failedCount > 0 ? 1 : 0;
+}
+
+struct OutputVariant
+// Output file and the spots disabled in it
+{
+    std::string outputFileName;
+    std::vector<std::string> spotNames;
+};
+
+bool ReadVariants( std::istream & variantsList,
+                   std::vector<OutputVariant> & variants )
+// Reads "out.pdf<TAB>SpotName1<TAB>...<TAB>SpotNameN" lines. Line without
+// spot names disables all spots. Empty lines and lines starting with '#'
+// are skipped. Returns false if some line is malformed.
+{
+    std::string line;
+    while ( std::getline( variantsList, line ) )
+    {
+        // Tolerate lists with DOS line ends
+        if ( not line.empty() && line[line.size() - 1] == '\r' )
+            line.erase( line.size() - 1 );
+        if ( line.empty() || line[0] == '#' ) continue;
+
+        OutputVariant variant;
+        std::istringstream fields( line );
+        std::getline( fields, variant.outputFileName, '\t' );
+        if ( variant.outputFileName.empty() )
+        {
+            std::cout << "Invalid variants line: " << line << std::endl;
+            return false;
+        }
+        std::string spotName;
+        while ( std::getline( fields, spotName, '\t' ) )
+        {
+            if ( not spotName.empty() ) variant.spotNames.push_back( spotName );
+        }
+        variants.push_back( variant );
+    }
+    return true;
+}
+
+int RunVariants( const std::string & inputFileName,
+                 const std::string & variantsFileName,
+                 const OutputOptions & outputOptions,
+                 RunStats & stats )
+// Loads inputFileName once and writes every output variant from it.
+// Returns program exit code.
+{
+    std::vector<OutputVariant> variants;
+    bool variantsValid;
+    if ( variantsFileName == "-" )
+    {
+        variantsValid = ReadVariants( std::cin, variants );
+    }
+    else
+    {
+        std::ifstream variantsList( variantsFileName.c_str() );
+        if ( not variantsList )
+        {
+            std::cout << "Can not open variants list " << variantsFileName
+                      << std::endl;
+            return 1;
+        }
+        variantsValid = ReadVariants( variantsList, variants );
+    }
+    if ( not variantsValid ) return 1;
+
+    ++stats.files;
+    const PdfInput input( inputFileName );
+    stats.inputBytes += input.GetSize();
+    bool mayContainSpots;
+    {
+        PhaseTimer timer( stats, RunStats::PHASE_PRESCAN );
+        mayContainSpots = MustBeParsed( input, outputOptions );
+    }
+    PoDoFo::PdfMemDocument pdfDoc;
+    std::vector<ColorReference> colorReferences;
+    if ( mayContainSpots )
+    {
+        {
+            PhaseTimer timer( stats, RunStats::PHASE_LOAD );
+            input.Load( pdfDoc );
+        }
+        PhaseTimer timer( stats, RunStats::PHASE_SCAN );
+        colorReferences = GetColorReferences( pdfDoc, input.GetSource(),
+                                              outputOptions.threadCount );
+        stats.pages += pdfDoc.GetPageCount();
+        stats.colorReferences += colorReferences.size();
+    }
+
+    size_t failedCount = 0;
+    std::vector<OutputVariant>::const_iterator it;
+    for ( it = variants.begin(); it != variants.end(); ++it )
+    {
+        const SpotMatcher spotMatcher( it->spotNames );
+        SpotDecisions spotsToDisable( spotMatcher );
+        std::vector<DisabledSpot> disabledSpots;
+        std::string errorMessage;
+        bool succeeded = false;
+        // Failed variant is reported and does not stop other variants
+        try
+        {
+            if ( not mayContainSpots )
+            {
+                succeeded = input.CopyTo( it->outputFileName );
+                if ( not succeeded ) errorMessage = "can not copy file";
+            }
+            else
+            {
+                {
+                    PhaseTimer timer( stats, RunStats::PHASE_REWRITE );
+                    DisableSpots( pdfDoc, colorReferences, spotsToDisable,
+                                  stats, disabledSpots );
+                }
+                PhaseTimer timer( stats, RunStats::PHASE_WRITE );
+                stats.outputBytes += SaveDocument( pdfDoc, input,
+                                                   disabledSpots,
+                                                   it->outputFileName,
+                                                   outputOptions );
+                succeeded = true;
+            }
+        }
+        catch ( const PoDoFo::PdfError & error )
+        {
+            errorMessage = error.what();
+        }
+        catch ( const std::exception & error )
+        {
+            errorMessage = error.what();
+        }
+        // Next variant starts from the original arrays
+        RestoreSpots( disabledSpots );
+        stats.spotCacheLookups += spotsToDisable.GetLookupCount();
+        stats.spotCacheHits += spotsToDisable.GetHitCount();
+
+        if ( succeeded )
+        {
+            if ( not mayContainSpots ) stats.outputBytes += input.GetSize();
+            std::cout << ( mayContainSpots ? "OK\t" : "COPIED\t" )
+                      << inputFileName << "\t" << it->outputFileName
+                      << std::endl;
+        }
+        else
+        {
+            ++failedCount;
+            std::cout << "FAILED\t" << it->outputFileName << "\t"
+                      << errorMessage << std::endl;
+        }
+    }
+    std::cout << "Written " << variants.size() - failedCount << " of "
+              << variants.size() << " variants." << std::endl;
+    return failedCount > 0 ? 1 : 0;
+}
+
+class ServerRequestHandler : public SpotRequestHandler
+// Answers "list<TAB>in.pdf" and
+// "disable<TAB>in.pdf<TAB>out.pdf[<TAB>SpotName1...<TAB>SpotNameN]"
+// daemon requests with one line of JSON
+{
+public:
+    explicit ServerRequestHandler( const OutputOptions & outputOptions )
+        : outputOptions( outputOptions )
+    {
+        // Connections are served in parallel already
+        this->outputOptions.threadCount = 1;
+    }
+
+    std::string Handle( const std::string & request )
+    {
+        std::vector<std::string> fields;
+        std::istringstream fieldStream( request );
+        std::string field;
+        while ( std::getline( fieldStream, field, '\t' ) )
+            fields.push_back( field );
+
+        // Daemon stdin and stdout are not the client's ones
+        bool valid = fields.size() >= 2 && fields[1] != "-"
+                     && ( ( fields[0] == "list" && fields.size() == 2 )
+                          || ( fields[0] == "disable" && fields.size() >= 3
+                               && fields[2] != "-" ) );
+        if ( not valid ) return ErrorResponse( "invalid request" );
+
+        RunStats stats;
+        std::ostringstream response;
+        // Failed request is reported and does not stop the daemon
+        try
+        {
+            if ( fields[0] == "list" )
+            {
+                const std::vector<std::string> spotNames
+                                    = ListSpotsInFile( fields[1], 1, stats );
+                response << "{\"status\":\"ok\",\"spots\":[";
+                for ( size_t i = 0; i < spotNames.size(); ++i )
+                    response << ( i > 0 ? "," : "" )
+                             << JsonString( spotNames[i] );
+                response << "]";
+            }
+            else
+            {
+                // Spot names are per request, so is the decisions cache
+                std::vector<std::string> spotNames;
+                for ( size_t i = 3; i < fields.size(); ++i )
+                    if ( not fields[i].empty() )
+                        spotNames.push_back( fields[i] );
+                const SpotMatcher spotMatcher( spotNames );
+                SpotDecisions spotsToDisable( spotMatcher );
+                bool parsed = DisableSpotsInFile( fields[1], fields[2],
+                                                  spotsToDisable,
+                                                  outputOptions, stats );
+                response << "{\"status\":\""
+                         << ( parsed ? "ok" : "copied" )
+                         << "\",\"disabled_spots\":" << stats.disabledSpots;
+            }
+            response << ",\"pages\":" << stats.pages << "}";
+        }
+        catch ( const PoDoFo::PdfError & error )
+        {
+            return ErrorResponse( error.what() );
+        }
+        catch ( const std::exception & error )
+        {
+            return ErrorResponse( error.what() );
+        }
+        catch ( ... )
+        {
+            return ErrorResponse( "unknown error" );
+        }
+        return response.str();
+    }
+
+private:
+    static std::string ErrorResponse( const std::string & message )
+    {
+        return "{\"status\":\"error\",\"message\":"
+               + JsonString( message ) + "}";
+    }
+
+    OutputOptions outputOptions;
+};
+
 int main( int argc, char* argv[] )
 {
     // Initialize command line parser
@@ -226,90 +1162,123 @@ int main( int argc, char* argv[] )
       PrintHelpMessage();
       return 0;
     }
+    // Options with values must be read before global options
+    std::string batchManifest;
+    commandLine >> GetOpt::Option('b', "batch", batchManifest);
+    unsigned int jobCount = WorkerPool::GetDefaultThreadCount();
+    commandLine >> GetOpt::Option('j', "jobs", jobCount);
+    std::string variantsList;
+    commandLine >> GetOpt::Option('v', "variants", variantsList);
+    std::string serverSocket;
+    commandLine >> GetOpt::Option("serve", serverSocket);
+    std::string reportFormat;
+    commandLine >> GetOpt::Option("report", reportFormat);
+    std::string inventoryLocation;
+    commandLine >> GetOpt::Option("inventory", inventoryLocation);
+    std::string cacheDirectory;
+    commandLine >> GetOpt::Option("cache", cacheDirectory);
+    unsigned long long cacheSize = 1024;
+    commandLine >> GetOpt::Option("cache-size", cacheSize);
     // Initialize vector for storing command line options
     std::vector<std::string> programOptions;
     commandLine >> GetOpt::GlobalOption(programOptions);
+    // In incremental mode out.pdf is the original file plus appended update
+    OutputOptions outputOptions;
+    outputOptions.incremental = commandLine >> GetOpt::OptionPresent('i',
+                                                              "incremental");
+    outputOptions.compressed = commandLine >> GetOpt::OptionPresent('z',
+                                                                "compress");
+    outputOptions.threadCount = jobCount;
+    bool statsMode = commandLine >> GetOpt::OptionPresent('s', "stats");
+    double startTime = GetWallTime();
+    RunStats stats;
+    int exitCode = 0;
+
+    // Spot names are compiled once and shared by all files
+    const std::vector<std::string> spotNameList
+                                    = GetSpotsToDisable(programOptions);
+    const SpotMatcher spotMatcher( spotNameList );
+    SpotDecisions spotsToDisable( spotMatcher );
+    // Repeated jobs are answered from results of earlier runs
+    std::auto_ptr<ResultCache> resultCache;
+    if ( not cacheDirectory.empty() )
+        resultCache.reset( new ResultCache( cacheDirectory,
+                                            cacheSize << 20 ) );
+    const std::string cacheParameters = GetCacheParameters( spotNameList,
+                                                            outputOptions );
 
-    if (not IsProgramOptionsValid(programOptions) )
+    // Daemon answers list/disable requests until SIGINT or SIGTERM
+    if ( not serverSocket.empty() )
+    {
+        ServerRequestHandler handler( outputOptions );
+        exitCode = RunSpotServer( serverSocket, handler, jobCount );
+    }
+    // In batch mode all global options are spot names
+    else if ( not batchManifest.empty() )
+    {
+        exitCode = RunBatch( batchManifest, spotsToDisable, outputOptions,
+                             resultCache.get(), cacheParameters,
+                             jobCount, stats );
+    }
+    else if ( not inventoryLocation.empty() )
+    {
+        exitCode = RunInventory( inventoryLocation, resultCache.get(),
+                                 jobCount, stats );
+    }
+    else if ( not IsProgramOptionsValid(programOptions)
+              || not ( reportFormat.empty() || reportFormat == "json"
+                       || reportFormat == "csv" ) )
     {
         std::cout << "Invalid command line option provided!" << std::endl;
         PrintHelpMessage();
         return 1;
     }
-    // Load pdf file
-    PoDoFo::PdfMemDocument pdfDoc( programOptions[0].c_str() );
-    // Initialize vector of pointers to all pdf objects
-    PoDoFo::PdfVecObjects pdfDocObjects = pdfDoc.GetObjects();
-    //Obtain references to color arrays
-    std::vector<PoDoFo::PdfReference> colorReferences = GetColorReferences(pdfDoc);
-
-    // List all spots from input file and exit if needed
-    if ( commandLine >> GetOpt::OptionPresent('l', "list") 
-         || programOptions.size() == 1 )
+    // One load, many outputs
+    else if ( not variantsList.empty() )
+    {
+        exitCode = RunVariants( programOptions[0], variantsList,
+                                outputOptions, stats );
+    }
+    else if ( not reportFormat.empty() )
+    {
+        PrintSpotReport( std::cout,
+                         GetSpotUsageInFile( programOptions[0],
+                                             jobCount, stats ),
+                         reportFormat );
+    }
+    // List all spots from input file if needed
+    else if ( commandLine >> GetOpt::OptionPresent('l', "list") 
+              || programOptions.size() == 1 )
+    {
+        const std::vector<std::string> spotNames
+                                = ListSpotsInFile( programOptions[0],
+                                                   jobCount, stats,
+                                                   resultCache.get() );
+        for ( size_t i = 0; i < spotNames.size(); ++i )
+            std::cout << spotNames[i] << std::endl;
+    }
+    else if ( not DisableSpotsInFile( programOptions[0], programOptions[1],
+                                      spotsToDisable, outputOptions,
+                                      stats, resultCache.get(),
+                                      cacheParameters ) )
     {
-        ListAvailableSpots( pdfDoc, colorReferences );
-        return 0;
+        // Nothing but pdf data may go to stdout
+        if ( programOptions[1] != "-" )
+            std::cout << "No spots found, " << programOptions[0]
+                      << " copied as is." << std::endl;
     }
 
-    //Normalized vector of given spot names being disabled
-    std::vector<std::string> spotsToDisable;
-    std::string temporarySpotName;
-    std::vector<std::string>::iterator iter = programOptions.begin();
-    while ( iter != programOptions.end() )
+    // Stats go to stderr to keep them apart from spot lists and reports
+    if ( statsMode )
     {
-        if ( not IsPdfFileName(*iter) )
+        stats.spotCacheLookups += spotsToDisable.GetLookupCount();
+        stats.spotCacheHits += spotsToDisable.GetHitCount();
+        if ( resultCache.get() != NULL )
         {
-            temporarySpotName = *iter;
-            // Convert SpotName to lowercase
-            std::transform(temporarySpotName.begin(), temporarySpotName.end(),
-                   temporarySpotName.begin(), ::tolower);
-            // Add temporarySpotName to the list of spots being disabled
-            spotsToDisable.push_back(temporarySpotName);
+            stats.resultCacheHits += resultCache->GetHitCount();
+            stats.resultCacheMisses += resultCache->GetMissCount();
         }
-        ++iter;
+        stats.PrintJson( std::cerr, GetWallTime() - startTime );
     }
-
-    // Iterate through all color arrays and disable spots if needed
-    PoDoFo::PdfObject* colorArrayObject;
-    PoDoFo::PdfArray colorArray;
-    std::vector<PoDoFo::PdfReference>::iterator it = colorReferences.begin();
-    while ( it != colorReferences.end() )
-    {
-        // Obtaining color array by reference
-        if ( pdfDoc.GetObjects().GetObject(*it)->IsArray() )
-        {
-            /* Color array for separation colorspace has 4 entries: 
-             * [ /Separation name alternateSpace tintTransform ]
-             * (see Pdf Reference, ch. 4.5.5)
-             * If name entry would be replaced with special name /None,
-             * all objects are using this colorspace become invisible.
-             */
-            // Get the pointer to colorArrayObject for future saving
-            colorArrayObject = pdfDocObjects.GetObject(*it);
-            // Get the copy of color array value
-            colorArray = colorArrayObject->GetArray();
-            //Processing color array entries
-            if ( colorArray.GetSize() > 1
-                 && colorArray[0].IsName()
-                 && colorArray[0].GetName().GetEscapedName() == "Separation"
-                 && colorArray[1].IsName() 
-                 && MustBeDisabled( colorArray[1].GetName().GetEscapedName(), 
-                                    spotsToDisable ) )
-            {
-                // Change the second array item to /None value
-                colorArray[1] = NONE_COLOR;
-                // Construct new object from reference to current color array
-                // and changed array value. Assign this new object value to
-                // current colorArray object
-                (*colorArrayObject) = PoDoFo::PdfObject ( 
-                                                colorArrayObject->Reference(),
-                                                colorArray );
-            } // Processing color array entries
-        } // Check if referenced object is an array
-        ++it;
-    } // Iterating through color references
-
-
-    pdfDoc.Write(programOptions[1].c_str());
-    return 0;
+    return exitCode;
 }
@@ -0,0 +1,272 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "pdfspot.h"
+
+#include <new>
+#include <memory>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <streambuf>
+
+#include "spot-disabler.h"
+
+struct pdfspot_document
+// SpotDisabler with the state C callers can not keep themselves
+{
+    std::auto_ptr<SpotDisabler> disabler;
+    OutputOptions outputOptions;
+    std::vector<std::string> spotNames;
+    std::string errorMessage;
+};
+
+namespace
+{
+
+// Message of the last failed pdfspot_open() of the thread, there is
+// no document to keep it
+__thread char openErrorMessage[256] = "";
+
+class CallbackStreamBuffer : public std::streambuf
+// Passes buffered output to pdfspot_write_callback
+{
+public:
+    CallbackStreamBuffer( pdfspot_write_callback callback, void* context )
+        : callback( callback ),
+          context( context ),
+          failed( false )
+    {
+        setp( buffer, buffer + sizeof(buffer) );
+    }
+
+    bool IsFailed() const { return failed; }
+
+protected:
+    int_type overflow( int_type symbol )
+    {
+        if ( not Drain() ) return traits_type::eof();
+        if ( traits_type::eq_int_type( symbol, traits_type::eof() ) )
+            return traits_type::not_eof( symbol );
+        *pptr() = traits_type::to_char_type( symbol );
+        pbump( 1 );
+        return symbol;
+    }
+
+    int sync()
+    {
+        return Drain() ? 0 : -1;
+    }
+
+private:
+    bool Drain()
+    {
+        size_t size = pptr() - pbase();
+        if ( failed || ( size > 0 && callback( pbase(), size, context ) != 0 ) )
+        {
+            failed = true;
+            return false;
+        }
+        setp( buffer, buffer + sizeof(buffer) );
+        return true;
+    }
+
+    pdfspot_write_callback callback;
+    void* context;
+    bool failed;
+    char buffer[1 << 16];
+};
+
+int GetErrorCode( std::string & errorMessage )
+// Translates exception being handled into error code and message
+{
+    try
+    {
+        throw;
+    }
+    catch ( const PoDoFo::PdfError & error )
+    {
+        errorMessage = error.what();
+        return PDFSPOT_ERROR_PDF;
+    }
+    catch ( const std::bad_alloc & error )
+    {
+        errorMessage = error.what();
+        return PDFSPOT_ERROR_MEMORY;
+    }
+    catch ( const std::exception & error )
+    {
+        errorMessage = error.what();
+        return PDFSPOT_ERROR_UNKNOWN;
+    }
+    catch ( ... )
+    {
+        errorMessage = "unknown error";
+        return PDFSPOT_ERROR_UNKNOWN;
+    }
+}
+
+int SetOpenError( int errorCode, const std::string & errorMessage )
+// Keeps message of failed pdfspot_open() for pdfspot_error_message( NULL )
+{
+    strncpy( openErrorMessage, errorMessage.c_str(),
+             sizeof(openErrorMessage) - 1 );
+    openErrorMessage[sizeof(openErrorMessage) - 1] = '\0';
+    return errorCode;
+}
+
+} // namespace
+
+int pdfspot_open( const char* data, size_t size, int flags,
+                  pdfspot_document** document )
+{
+    if ( document == NULL )
+        return SetOpenError( PDFSPOT_ERROR_ARGUMENT, "NULL document pointer" );
+    *document = NULL;
+    if ( data == NULL )
+        return SetOpenError( PDFSPOT_ERROR_ARGUMENT, "NULL data" );
+    pdfspot_document* newDocument = new ( std::nothrow ) pdfspot_document;
+    if ( newDocument == NULL )
+        return SetOpenError( PDFSPOT_ERROR_MEMORY, "out of memory" );
+    try
+    {
+        newDocument->outputOptions.incremental
+                                    = ( flags & PDFSPOT_INCREMENTAL ) != 0;
+        newDocument->outputOptions.compressed
+                                    = ( flags & PDFSPOT_COMPRESS ) != 0;
+        newDocument->disabler.reset( new SpotDisabler( data, size ) );
+    }
+    catch ( ... )
+    {
+        std::string errorMessage;
+        int errorCode = GetErrorCode( errorMessage );
+        delete newDocument;
+        return SetOpenError( errorCode, errorMessage );
+    }
+    *document = newDocument;
+    return PDFSPOT_OK;
+}
+
+void pdfspot_close( pdfspot_document* document )
+{
+    delete document;
+}
+
+const char* pdfspot_error_message( const pdfspot_document* document )
+{
+    return document == NULL ? openErrorMessage
+                            : document->errorMessage.c_str();
+}
+
+int pdfspot_list_spots( pdfspot_document* document, size_t* spot_count )
+{
+    if ( document == NULL || spot_count == NULL )
+        return PDFSPOT_ERROR_ARGUMENT;
+    try
+    {
+        document->spotNames = document->disabler->ListSpots();
+        *spot_count = document->spotNames.size();
+    }
+    catch ( ... )
+    {
+        return GetErrorCode( document->errorMessage );
+    }
+    return PDFSPOT_OK;
+}
+
+const char* pdfspot_spot_name( const pdfspot_document* document,
+                               size_t index )
+{
+    if ( document == NULL || index >= document->spotNames.size() )
+        return NULL;
+    return document->spotNames[index].c_str();
+}
+
+int pdfspot_disable_spots( pdfspot_document* document,
+                           const char* const* spot_names,
+                           size_t spot_name_count,
+                           size_t* disabled_count )
+{
+    if ( document == NULL || ( spot_names == NULL && spot_name_count > 0 ) )
+        return PDFSPOT_ERROR_ARGUMENT;
+    try
+    {
+        std::vector<std::string> spotNames( spot_names,
+                                            spot_names + spot_name_count );
+        unsigned long disabledCount
+                            = document->disabler->DisableSpots( spotNames );
+        if ( disabled_count != NULL ) *disabled_count = disabledCount;
+    }
+    catch ( ... )
+    {
+        return GetErrorCode( document->errorMessage );
+    }
+    return PDFSPOT_OK;
+}
+
+int pdfspot_set_thread_count( pdfspot_document* document,
+                              unsigned int thread_count )
+{
+    if ( document == NULL || thread_count == 0 )
+        return PDFSPOT_ERROR_ARGUMENT;
+    document->disabler->SetThreadCount( thread_count );
+    document->outputOptions.threadCount = thread_count;
+    return PDFSPOT_OK;
+}
+
+int pdfspot_restore_spots( pdfspot_document* document )
+{
+    if ( document == NULL ) return PDFSPOT_ERROR_ARGUMENT;
+    try
+    {
+        document->disabler->RestoreSpots();
+    }
+    catch ( ... )
+    {
+        return GetErrorCode( document->errorMessage );
+    }
+    return PDFSPOT_OK;
+}
+
+int pdfspot_write( pdfspot_document* document,
+                   pdfspot_write_callback callback, void* context )
+{
+    if ( document == NULL || callback == NULL )
+        return PDFSPOT_ERROR_ARGUMENT;
+    CallbackStreamBuffer outputBuffer( callback, context );
+    try
+    {
+        std::ostream output( &outputBuffer );
+        document->disabler->Write( output, document->outputOptions );
+        output.flush();
+    }
+    catch ( ... )
+    {
+        int errorCode = GetErrorCode( document->errorMessage );
+        return outputBuffer.IsFailed() ? PDFSPOT_ERROR_WRITE : errorCode;
+    }
+    if ( outputBuffer.IsFailed() )
+    {
+        document->errorMessage = "write callback failed";
+        return PDFSPOT_ERROR_WRITE;
+    }
+    return PDFSPOT_OK;
+}
@@ -0,0 +1,117 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef PDFSPOT_H
+#define PDFSPOT_H
+
+/* C interface of libpdfspot: listing and disabling spot colors of pdf
+ * documents held in memory. Functions return PDFSPOT_OK or an error
+ * code; details of the last error are kept in the document, details
+ * of a failed pdfspot_open() are kept for the calling thread.
+ * One document must not be used by several threads at once,
+ * different documents can.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum
+{
+    PDFSPOT_OK = 0,
+    /* NULL document or output pointer */
+    PDFSPOT_ERROR_ARGUMENT = 1,
+    /* Data is not a valid pdf document */
+    PDFSPOT_ERROR_PDF = 2,
+    /* Output callback failed */
+    PDFSPOT_ERROR_WRITE = 3,
+    PDFSPOT_ERROR_MEMORY = 4,
+    PDFSPOT_ERROR_UNKNOWN = 5
+};
+
+/* Flags of pdfspot_open() */
+enum
+{
+    /* Write only the changed objects appended to the original data */
+    PDFSPOT_INCREMENTAL = 1,
+    /* Write compressed object streams and xref stream */
+    PDFSPOT_COMPRESS = 2
+};
+
+typedef struct pdfspot_document pdfspot_document;
+
+/* Receives written pdf data piece by piece. Returns 0 on success. */
+typedef int ( *pdfspot_write_callback )( const char* data, size_t size,
+                                         void* context );
+
+/* Parses size bytes of pdf data. Data is read in place and must stay
+ * valid until pdfspot_close(). On failure *document is NULL and
+ * pdfspot_error_message( NULL ) tells why.
+ */
+int pdfspot_open( const char* data, size_t size, int flags,
+                  pdfspot_document** document );
+
+void pdfspot_close( pdfspot_document* document );
+
+/* Message of the last error of document, empty string if none.
+ * For NULL document it is the message of the last failed pdfspot_open()
+ * of the calling thread.
+ */
+const char* pdfspot_error_message( const pdfspot_document* document );
+
+/* Collects spot names of document, which are then available
+ * through pdfspot_spot_name() until the next call.
+ */
+int pdfspot_list_spots( pdfspot_document* document, size_t* spot_count );
+
+/* Spot name collected by pdfspot_list_spots(), NULL if index is out
+ * of range
+ */
+const char* pdfspot_spot_name( const pdfspot_document* document,
+                               size_t index );
+
+/* Disables spots whose names contain any of spot_names, case independent.
+ * Zero spot_name_count disables all spots. disabled_count may be NULL.
+ */
+int pdfspot_disable_spots( pdfspot_document* document,
+                           const char* const* spot_names,
+                           size_t spot_name_count,
+                           size_t* disabled_count );
+
+/* Threads scanning pages and compressing output of document,
+ * 1 by default
+ */
+int pdfspot_set_thread_count( pdfspot_document* document,
+                              unsigned int thread_count );
+
+/* Undoes all pdfspot_disable_spots() calls */
+int pdfspot_restore_spots( pdfspot_document* document );
+
+/* Writes document in its current state through callback */
+int pdfspot_write( pdfspot_document* document,
+                   pdfspot_write_callback callback, void* context );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PDFSPOT_H */
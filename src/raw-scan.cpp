@@ -0,0 +1,168 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "raw-scan.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+namespace
+{
+
+// Color space families having spot colorants
+const char* const SPOT_MARKERS[] = { "/Separation", "/DeviceN",
+                                     "/NChannel" };
+/* Objects packed into compressed object streams (see Pdf Reference,
+ * ch. 3.4.6) are not visible in raw bytes.
+ */
+const char* const OPAQUE_MARKERS[] = { "/ObjStm" };
+
+bool ContainsAny( const char* data, size_t size,
+                  const char* const markers[], size_t markerCount )
+{
+    for ( size_t i = 0; i < markerCount; ++i )
+    {
+        // glibc memmem is vectorized, so the whole file is scanned
+        // at memory bandwidth
+        if ( memmem( data, size, markers[i], strlen( markers[i] ) ) != NULL )
+            return true;
+    }
+    return false;
+}
+
+class FileDescriptor
+// Closes file descriptor when goes out of scope
+{
+public:
+    explicit FileDescriptor( int descriptor ) : fd( descriptor ) {}
+    ~FileDescriptor() { if ( fd >= 0 ) close( fd ); }
+    int Get() const { return fd; }
+private:
+    int fd;
+    FileDescriptor( const FileDescriptor & );
+    FileDescriptor & operator= ( const FileDescriptor & );
+};
+
+bool WriteAll( int fd, const char* data, size_t size )
+{
+    while ( size > 0 )
+    {
+        ssize_t written = write( fd, data, size );
+        if ( written < 0 )
+        {
+            if ( errno == EINTR ) continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+} // namespace
+
+bool MayContainSpots( const char* data, size_t size )
+{
+    return ContainsAny( data, size, SPOT_MARKERS,
+                        sizeof(SPOT_MARKERS) / sizeof(SPOT_MARKERS[0]) )
+           || ContainsAny( data, size, OPAQUE_MARKERS,
+                        sizeof(OPAQUE_MARKERS) / sizeof(OPAQUE_MARKERS[0]) );
+}
+
+bool MayContainSpots( const std::string & fileName )
+{
+    FileDescriptor file( open( fileName.c_str(), O_RDONLY ) );
+    struct stat fileStat;
+    if ( file.Get() < 0 || fstat( file.Get(), &fileStat ) != 0 ) return true;
+    if ( fileStat.st_size == 0 ) return true;
+
+    void* data = mmap( NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE,
+                       file.Get(), 0 );
+    if ( data == MAP_FAILED ) return true;
+    madvise( data, fileStat.st_size, MADV_SEQUENTIAL );
+
+    bool result = MayContainSpots( static_cast<const char*>( data ),
+                                   fileStat.st_size );
+    munmap( data, fileStat.st_size );
+    return result;
+}
+
+bool WritePdfData( const char* data, size_t size,
+                   const std::string & outputFileName )
+{
+    if ( outputFileName == "-" ) return WriteAll( STDOUT_FILENO, data, size );
+
+    FileDescriptor output( open( outputFileName.c_str(),
+                                 O_WRONLY | O_CREAT | O_TRUNC, 0666 ) );
+    return output.Get() >= 0 && WriteAll( output.Get(), data, size );
+}
+
+bool CopyPdfFile( const std::string & inputFileName,
+                  const std::string & outputFileName )
+{
+    FileDescriptor input( open( inputFileName.c_str(), O_RDONLY ) );
+    struct stat inputStat;
+    if ( input.Get() < 0 || fstat( input.Get(), &inputStat ) != 0 )
+        return false;
+
+    bool toStdout = outputFileName == "-";
+    // Copying file onto itself would truncate it
+    struct stat outputStat;
+    if ( not toStdout
+         && stat( outputFileName.c_str(), &outputStat ) == 0
+         && outputStat.st_dev == inputStat.st_dev
+         && outputStat.st_ino == inputStat.st_ino ) return true;
+
+    FileDescriptor output( toStdout ? -1
+                                    : open( outputFileName.c_str(),
+                                            O_WRONLY | O_CREAT | O_TRUNC,
+                                            0666 ) );
+    int outputFd = toStdout ? STDOUT_FILENO : output.Get();
+    if ( outputFd < 0 ) return false;
+
+#ifdef FICLONE
+    // Copy-on-write clone costs no data copying at all (btrfs, xfs)
+    if ( not toStdout && ioctl( outputFd, FICLONE, input.Get() ) == 0 )
+        return true;
+#endif
+
+    // Hard links are not used: changing out.pdf later would change in.pdf
+    std::string buffer( 1 << 20, '\0' );
+    while ( true )
+    {
+        ssize_t bytesRead = read( input.Get(), &buffer[0], buffer.size() );
+        if ( bytesRead < 0 )
+        {
+            if ( errno == EINTR ) continue;
+            return false;
+        }
+        if ( bytesRead == 0 ) return true;
+        if ( not WriteAll( outputFd, buffer.data(), bytesRead ) )
+            return false;
+    }
+}
@@ -0,0 +1,44 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef RAW_SCAN_H
+#define RAW_SCAN_H
+
+#include <string>
+#include <cstddef>
+
+// Checks raw bytes of pdf file for color spaces the tool can change.
+// False means that processing fileName can not change anything.
+// In doubt (unreadable file, compressed object streams) returns true,
+// so that the file goes through the full PoDoFo processing.
+bool MayContainSpots( const std::string & fileName );
+// The same check for pdf file already read into memory
+bool MayContainSpots( const char* data, size_t size );
+
+// Writes data to outputFileName, "-" is stdout. Returns false on failure.
+bool WritePdfData( const char* data, size_t size,
+                   const std::string & outputFileName );
+
+// Copies inputFileName to outputFileName ("-" is stdout), sharing file
+// extents (reflink) when filesystem supports it. Returns false on failure.
+bool CopyPdfFile( const std::string & inputFileName,
+                  const std::string & outputFileName );
+
+#endif // RAW_SCAN_H
@@ -0,0 +1,325 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "result-cache.h"
+
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <openssl/evp.h>
+#include "worker-pool.h"
+#include "raw-scan.h"
+
+#ifndef PACKAGE_VERSION
+#define PACKAGE_VERSION "unknown"
+#endif
+
+namespace
+{
+
+const char* const TEMPORARY_PREFIX = ".tmp-";
+// Older temporary files were left by writers which crashed
+const time_t MAX_TEMPORARY_AGE = 60 * 60;
+
+class Sha256Hash
+// SHA-256 of data given in pieces, computed by libcrypto. Cache keys
+// must tell inputs apart as reliably as their contents themselves.
+{
+public:
+    Sha256Hash()
+        : context( EVP_MD_CTX_create() ),
+          failed( context == NULL
+                  || EVP_DigestInit_ex( context, EVP_sha256(), NULL ) != 1 )
+    {}
+
+    ~Sha256Hash()
+    {
+        if ( context != NULL ) EVP_MD_CTX_destroy( context );
+    }
+
+    void Update( const void* data, size_t size )
+    {
+        if ( not failed )
+            failed = EVP_DigestUpdate( context, data, size ) != 1;
+    }
+
+    // Hex digits of the hash, empty on failure.
+    // The object can not be updated after that.
+    std::string Finish()
+    {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int digestSize = 0;
+        if ( failed
+             || EVP_DigestFinal_ex( context, digest, &digestSize ) != 1 )
+            return std::string();
+        failed = true;
+        const char* HEX = "0123456789abcdef";
+        std::string digits;
+        for ( unsigned int i = 0; i < digestSize; ++i )
+        {
+            digits += HEX[digest[i] >> 4];
+            digits += HEX[digest[i] & 0xF];
+        }
+        return digits;
+    }
+
+private:
+    EVP_MD_CTX* context;
+    bool failed;
+
+    Sha256Hash( const Sha256Hash & );
+    Sha256Hash & operator= ( const Sha256Hash & );
+};
+
+void StartKey( Sha256Hash & hash, const std::string & parameters )
+// Hashes program version and parameters ahead of the input contents.
+// Lengths come first, so that no other split of the same bytes
+// into version, parameters and contents gives the same key.
+{
+    const std::string version = PACKAGE_VERSION;
+    std::ostringstream head;
+    head << version.size() << " " << version
+         << parameters.size() << " " << parameters;
+    const std::string headData = head.str();
+    hash.Update( headData.data(), headData.size() );
+}
+
+struct CacheEntry
+// File of the cache directory, ordered from the least recently used
+{
+    std::string fileName;
+    time_t usedTime;
+    unsigned long long size;
+
+    bool operator< ( const CacheEntry & other ) const
+    {
+        return usedTime < other.usedTime;
+    }
+};
+
+} // namespace
+
+ResultCache::ResultCache( const std::string & directory,
+                          unsigned long long maxSize )
+    : directory( directory ),
+      maxSize( maxSize ),
+      temporaryCount( 0 ),
+      hitCount( 0 ),
+      missCount( 0 ),
+      totalSize( 0 )
+{
+    // Missing directory makes every lookup a miss and every store a no-op
+    mkdir( directory.c_str(), 0777 );
+    pthread_mutex_init( &mutex, NULL );
+    Evict();
+}
+
+ResultCache::~ResultCache()
+{
+    pthread_mutex_destroy( &mutex );
+}
+
+std::string ResultCache::GetKey( const std::string & inputFileName,
+                                 const std::string & parameters ) const
+{
+    int input = open( inputFileName.c_str(), O_RDONLY );
+    if ( input < 0 ) return std::string();
+    Sha256Hash hash;
+    StartKey( hash, parameters );
+    std::string buffer( 1 << 20, '\0' );
+    ssize_t bytesRead;
+    while ( ( bytesRead = read( input, &buffer[0], buffer.size() ) ) != 0 )
+    {
+        if ( bytesRead < 0 && errno == EINTR ) continue;
+        if ( bytesRead < 0 ) break;
+        hash.Update( buffer.data(), bytesRead );
+    }
+    close( input );
+    if ( bytesRead < 0 ) return std::string();
+    return hash.Finish();
+}
+
+std::string ResultCache::GetKey( const char* data, size_t size,
+                                 const std::string & parameters ) const
+{
+    Sha256Hash hash;
+    StartKey( hash, parameters );
+    hash.Update( data, size );
+    return hash.Finish();
+}
+
+bool ResultCache::Fetch( const std::string & key,
+                         const std::string & outputFileName )
+{
+    const std::string entryName = GetEntryName( key );
+    // Modification time of the entry is its last use time
+    bool hit = utime( entryName.c_str(), NULL ) == 0
+               && CopyPdfFile( entryName, outputFileName );
+    CountLookup( hit );
+    return hit;
+}
+
+bool ResultCache::FetchData( const std::string & key, std::string & data )
+{
+    const std::string entryName = GetEntryName( key );
+    bool hit = false;
+    if ( utime( entryName.c_str(), NULL ) == 0 )
+    {
+        std::ifstream entry( entryName.c_str(), std::ios::binary );
+        std::ostringstream contents;
+        contents << entry.rdbuf();
+        hit = not entry.bad();
+        if ( hit ) data = contents.str();
+    }
+    CountLookup( hit );
+    return hit;
+}
+
+void ResultCache::Store( const std::string & key,
+                         const std::string & fileName )
+{
+    const std::string temporaryName = GetTemporaryName();
+    // Output file is usually cloned, not copied
+    if ( CopyPdfFile( fileName, temporaryName ) )
+        Commit( temporaryName, key );
+    else
+        unlink( temporaryName.c_str() );
+}
+
+void ResultCache::StoreData( const std::string & key,
+                             const std::string & data )
+{
+    const std::string temporaryName = GetTemporaryName();
+    if ( WritePdfData( data.data(), data.size(), temporaryName ) )
+        Commit( temporaryName, key );
+    else
+        unlink( temporaryName.c_str() );
+}
+
+unsigned long ResultCache::GetHitCount() const
+{
+    MutexLock lock( mutex );
+    return hitCount;
+}
+
+unsigned long ResultCache::GetMissCount() const
+{
+    MutexLock lock( mutex );
+    return missCount;
+}
+
+std::string ResultCache::GetEntryName( const std::string & key ) const
+{
+    return directory + "/" + key;
+}
+
+std::string ResultCache::GetTemporaryName()
+// Name unique among threads and processes sharing the directory
+{
+    MutexLock lock( mutex );
+    std::ostringstream name;
+    name << directory << "/" << TEMPORARY_PREFIX << getpid() << "-"
+         << temporaryCount++;
+    return name.str();
+}
+
+void ResultCache::CountLookup( bool hit )
+{
+    MutexLock lock( mutex );
+    ++( hit ? hitCount : missCount );
+}
+
+void ResultCache::Commit( const std::string & temporaryName,
+                          const std::string & key )
+{
+    const std::string entryName = GetEntryName( key );
+    struct stat status;
+    unsigned long long size = 0, replacedSize = 0;
+    if ( stat( temporaryName.c_str(), &status ) == 0 )
+        size = status.st_size;
+    // Entry may be stored again, e.g. by another process
+    if ( stat( entryName.c_str(), &status ) == 0 )
+        replacedSize = status.st_size;
+    // Readers see either no entry or a complete one
+    if ( rename( temporaryName.c_str(), entryName.c_str() ) != 0 )
+    {
+        unlink( temporaryName.c_str() );
+        return;
+    }
+    MutexLock lock( mutex );
+    totalSize += size;
+    // Replaced entry may have been stored by another process unnoticed
+    totalSize -= std::min( totalSize, replacedSize );
+    if ( totalSize > maxSize ) Evict();
+}
+
+void ResultCache::Evict()
+// Sums sizes of the entries into totalSize and removes least recently
+// used ones until the size limit is met. Temporary files older than
+// MAX_TEMPORARY_AGE are removed too. Called with mutex locked.
+{
+    totalSize = 0;
+    DIR* cacheDirectory = opendir( directory.c_str() );
+    if ( cacheDirectory == NULL ) return;
+    std::vector<CacheEntry> entries;
+    const time_t now = time( NULL );
+    const size_t prefixLength = strlen( TEMPORARY_PREFIX );
+    while ( struct dirent* item = readdir( cacheDirectory ) )
+    {
+        const std::string name = item->d_name;
+        if ( name == "." || name == ".." ) continue;
+        CacheEntry entry;
+        entry.fileName = directory + "/" + name;
+        struct stat status;
+        if ( stat( entry.fileName.c_str(), &status ) != 0
+             || not S_ISREG( status.st_mode ) ) continue;
+        if ( name.compare( 0, prefixLength, TEMPORARY_PREFIX ) == 0 )
+        {
+            // Files being written are recent
+            if ( now - status.st_mtime > MAX_TEMPORARY_AGE )
+                unlink( entry.fileName.c_str() );
+            continue;
+        }
+        if ( name[0] == '.' ) continue;
+        entry.usedTime = status.st_mtime;
+        entry.size = status.st_size;
+        totalSize += entry.size;
+        entries.push_back( entry );
+    }
+    closedir( cacheDirectory );
+    if ( totalSize <= maxSize ) return;
+
+    std::sort( entries.begin(), entries.end() );
+    for ( size_t i = 0; i < entries.size() && totalSize > maxSize; ++i )
+    {
+        // Entry removed by another process still frees its space
+        unlink( entries[i].fileName.c_str() );
+        totalSize -= entries[i].size;
+    }
+}
@@ -0,0 +1,84 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <string>
+#include <pthread.h>
+
+class ResultCache
+// Directory of earlier results, one file per entry, named by SHA-256
+// of the input pdf contents and of the parameters which produced it.
+// Least recently used entries are removed when the total size exceeds
+// the limit. Can be shared by threads and by processes using the same
+// directory: entries are written under temporary names and renamed.
+// The size is counted in memory, the directory is scanned when created
+// and when the limit is exceeded, which also finds entries of others.
+{
+public:
+    ResultCache( const std::string & directory,
+                 unsigned long long maxSize );
+    ~ResultCache();
+
+    // Key of inputFileName contents with parameters, which must list
+    // everything the result depends on but the program version.
+    // Empty if input can not be read.
+    std::string GetKey( const std::string & inputFileName,
+                        const std::string & parameters ) const;
+    // The same for pdf file already read into memory
+    std::string GetKey( const char* data, size_t size,
+                        const std::string & parameters ) const;
+
+    // Copies entry to outputFileName ("-" is stdout). False if missing.
+    bool Fetch( const std::string & key, const std::string & outputFileName );
+    // Reads entry into data. False if missing.
+    bool FetchData( const std::string & key, std::string & data );
+    // Adds a copy of fileName as the entry
+    void Store( const std::string & key, const std::string & fileName );
+    // Adds data as the entry
+    void StoreData( const std::string & key, const std::string & data );
+
+    unsigned long GetHitCount() const;
+    unsigned long GetMissCount() const;
+
+private:
+    std::string GetEntryName( const std::string & key ) const;
+    std::string GetTemporaryName();
+    void CountLookup( bool hit );
+    // Renames temporary file to the entry and evicts old entries
+    void Commit( const std::string & temporaryName, const std::string & key );
+    // Scans the directory, counting and removing entries over the limit
+    void Evict();
+
+    std::string directory;
+    unsigned long long maxSize;
+    unsigned long temporaryCount;
+    unsigned long hitCount;
+    unsigned long missCount;
+    // Size of all entries as of the last scan and stores since then
+    unsigned long long totalSize;
+    mutable pthread_mutex_t mutex;
+
+    ResultCache( const ResultCache & );
+    ResultCache & operator= ( const ResultCache & );
+};
+
+#endif // RESULT_CACHE_H
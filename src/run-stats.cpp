@@ -0,0 +1,226 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "run-stats.h"
+
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+namespace
+{
+
+const char* const PHASE_NAMES[RunStats::PHASE_COUNT] =
+    { "prescan", "load", "scan", "rewrite", "write" };
+
+double ClockSeconds( clockid_t clock )
+{
+    struct timespec now;
+    if ( clock_gettime( clock, &now ) != 0 ) return 0;
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Cpu time of worker threads added by AddWorkerCpuTime() on this thread
+__thread double workerCpuSeconds = 0;
+
+double TimevalSeconds( const struct timeval & time )
+{
+    return time.tv_sec + time.tv_usec / 1e6;
+}
+
+size_t GetUtf8SequenceLength( const std::string & value, size_t start )
+// Length of well-formed UTF-8 multibyte sequence at start, 0 if there
+// is none: overlong forms, surrogates and code points over U+10FFFF
+// are malformed (see Unicode Standard, table 3-7)
+{
+    unsigned char lead = value[start];
+    size_t length;
+    unsigned char low = 0x80, high = 0xBF;
+    if ( lead >= 0xC2 && lead <= 0xDF ) length = 2;
+    else if ( lead >= 0xE0 && lead <= 0xEF ) length = 3;
+    else if ( lead >= 0xF0 && lead <= 0xF4 ) length = 4;
+    else return 0;
+    // Second byte range is narrower for some lead bytes
+    if ( lead == 0xE0 ) low = 0xA0;
+    else if ( lead == 0xED ) high = 0x9F;
+    else if ( lead == 0xF0 ) low = 0x90;
+    else if ( lead == 0xF4 ) high = 0x8F;
+
+    if ( value.size() - start < length ) return 0;
+    for ( size_t i = 1; i < length; ++i )
+    {
+        unsigned char symbol = value[start + i];
+        if ( symbol < low || symbol > high ) return 0;
+        low = 0x80;
+        high = 0xBF;
+    }
+    return length;
+}
+
+} // namespace
+
+double GetWallTime()
+{
+    return ClockSeconds( CLOCK_MONOTONIC );
+}
+
+double GetThreadCpuTime()
+{
+    return ClockSeconds( CLOCK_THREAD_CPUTIME_ID );
+}
+
+void AddWorkerCpuTime( double cpuSeconds )
+{
+    workerCpuSeconds += cpuSeconds;
+}
+
+std::string JsonString( const std::string & value )
+{
+    std::string result( 1, '"' );
+    for ( size_t i = 0; i < value.size(); ++i )
+    {
+        unsigned char symbol = value[i];
+        size_t length = symbol < 0x80 ? 1 : GetUtf8SequenceLength( value, i );
+        if ( symbol == '"' || symbol == '\\' )
+        {
+            result += '\\';
+            result += symbol;
+        }
+        else if ( symbol < 0x20 || length == 0 )
+        {
+            // Byte out of valid UTF-8 is taken as Latin-1 character
+            const char* HEX = "0123456789abcdef";
+            result += "\\u00";
+            result += HEX[symbol >> 4];
+            result += HEX[symbol & 0xF];
+        }
+        else
+        {
+            result.append( value, i, length );
+            i += length - 1;
+        }
+    }
+    result += '"';
+    return result;
+}
+
+unsigned long long GetFileSize( const char* fileName )
+{
+    struct stat fileStat;
+    if ( stat( fileName, &fileStat ) != 0 ) return 0;
+    return fileStat.st_size;
+}
+
+RunStats::RunStats()
+    : files( 0 ),
+      filesCopied( 0 ),
+      pages( 0 ),
+      colorReferences( 0 ),
+      separationArrays( 0 ),
+      deviceNArrays( 0 ),
+      disabledSpots( 0 ),
+      inputBytes( 0 ),
+      outputBytes( 0 ),
+      spotCacheLookups( 0 ),
+      spotCacheHits( 0 ),
+      resultCacheHits( 0 ),
+      resultCacheMisses( 0 )
+{
+    for ( int i = 0; i < PHASE_COUNT; ++i )
+    {
+        wallTimes[i] = 0;
+        cpuTimes[i] = 0;
+    }
+}
+
+void RunStats::AddPhaseTime( Phase phase, double wallSeconds,
+                             double cpuSeconds )
+{
+    wallTimes[phase] += wallSeconds;
+    cpuTimes[phase] += cpuSeconds;
+}
+
+void RunStats::Add( const RunStats & other )
+{
+    files += other.files;
+    filesCopied += other.filesCopied;
+    pages += other.pages;
+    colorReferences += other.colorReferences;
+    separationArrays += other.separationArrays;
+    deviceNArrays += other.deviceNArrays;
+    disabledSpots += other.disabledSpots;
+    inputBytes += other.inputBytes;
+    outputBytes += other.outputBytes;
+    spotCacheLookups += other.spotCacheLookups;
+    spotCacheHits += other.spotCacheHits;
+    resultCacheHits += other.resultCacheHits;
+    resultCacheMisses += other.resultCacheMisses;
+    for ( int i = 0; i < PHASE_COUNT; ++i )
+        AddPhaseTime( static_cast<Phase>( i ),
+                      other.wallTimes[i], other.cpuTimes[i] );
+}
+
+void RunStats::PrintJson( std::ostream & output,
+                          double totalWallSeconds ) const
+{
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+
+    output << "{\"files\":" << files
+           << ",\"files_copied\":" << filesCopied
+           << ",\"pages\":" << pages
+           << ",\"color_references\":" << colorReferences
+           << ",\"separation_arrays\":" << separationArrays
+           << ",\"device_n_arrays\":" << deviceNArrays
+           << ",\"disabled_spots\":" << disabledSpots
+           << ",\"input_bytes\":" << inputBytes
+           << ",\"output_bytes\":" << outputBytes
+           << ",\"spot_cache\":{\"lookups\":" << spotCacheLookups
+           << ",\"hits\":" << spotCacheHits << "}"
+           << ",\"result_cache\":{\"hits\":" << resultCacheHits
+           << ",\"misses\":" << resultCacheMisses << "}"
+           << ",\"phases\":{";
+    for ( int i = 0; i < PHASE_COUNT; ++i )
+    {
+        if ( i > 0 ) output << ",";
+        output << "\"" << PHASE_NAMES[i] << "\":{\"wall_s\":" << wallTimes[i]
+               << ",\"cpu_s\":" << cpuTimes[i] << "}";
+    }
+    // ru_maxrss is in kilobytes on Linux
+    output << "},\"wall_s\":" << totalWallSeconds
+           << ",\"cpu_s\":" << TimevalSeconds( usage.ru_utime )
+                                + TimevalSeconds( usage.ru_stime )
+           << ",\"peak_rss_kb\":" << usage.ru_maxrss
+           << "}" << std::endl;
+}
+
+PhaseTimer::PhaseTimer( RunStats & stats, RunStats::Phase phase )
+    : stats( stats ),
+      phase( phase ),
+      wallStart( GetWallTime() ),
+      cpuStart( GetThreadCpuTime() + workerCpuSeconds )
+{}
+
+PhaseTimer::~PhaseTimer()
+{
+    stats.AddPhaseTime( phase, GetWallTime() - wallStart,
+                        GetThreadCpuTime() + workerCpuSeconds - cpuStart );
+}
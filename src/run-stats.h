@@ -0,0 +1,104 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+#include <ostream>
+#include <string>
+
+class RunStats
+// Counters and phase times of pdf files processing.
+// Not synchronized: every thread fills its own instance, Add() merges them.
+{
+public:
+    enum Phase
+    {
+        PHASE_PRESCAN,
+        PHASE_LOAD,
+        PHASE_SCAN,
+        PHASE_REWRITE,
+        PHASE_WRITE,
+        PHASE_COUNT
+    };
+
+    RunStats();
+
+    void AddPhaseTime( Phase phase, double wallSeconds, double cpuSeconds );
+    // Adds all counters and times of other to this instance
+    void Add( const RunStats & other );
+    // Prints stats as single line JSON object. Total cpu time
+    // of the process and its peak memory usage are added at print time.
+    void PrintJson( std::ostream & output, double totalWallSeconds ) const;
+
+    unsigned long files;
+    unsigned long filesCopied;
+    unsigned long pages;
+    unsigned long colorReferences;
+    unsigned long separationArrays;
+    unsigned long deviceNArrays;
+    unsigned long disabledSpots;
+    unsigned long long inputBytes;
+    unsigned long long outputBytes;
+    unsigned long spotCacheLookups;
+    unsigned long spotCacheHits;
+    unsigned long resultCacheHits;
+    unsigned long resultCacheMisses;
+
+private:
+    double wallTimes[PHASE_COUNT];
+    double cpuTimes[PHASE_COUNT];
+};
+
+class PhaseTimer
+// Measures wall time and cpu time of the calling thread, including
+// time of its workers added by AddWorkerCpuTime(), from construction
+// till destruction and adds them to the phase
+{
+public:
+    PhaseTimer( RunStats & stats, RunStats::Phase phase );
+    ~PhaseTimer();
+private:
+    RunStats & stats;
+    RunStats::Phase phase;
+    double wallStart;
+    double cpuStart;
+    PhaseTimer( const PhaseTimer & );
+    PhaseTimer & operator= ( const PhaseTimer & );
+};
+
+// Monotonic wall clock time in seconds
+double GetWallTime();
+
+// Cpu time of the calling thread in seconds
+double GetThreadCpuTime();
+
+// Adds cpu time spent by worker threads on behalf of the calling thread,
+// so that PhaseTimer running on it counts the time in its phase
+void AddWorkerCpuTime( double cpuSeconds );
+
+// Quoted JSON string with value escaped. Bytes which are not a part
+// of well-formed UTF-8 are escaped as Latin-1 characters.
+std::string JsonString( const std::string & value );
+
+// Size of the file in bytes, 0 if it can not be obtained
+unsigned long long GetFileSize( const char* fileName );
+
+#endif // RUN_STATS_H
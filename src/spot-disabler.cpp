@@ -0,0 +1,1243 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "spot-disabler.h"
+
+#include <algorithm>
+#include <deque>
+#include <tr1/unordered_map>
+#include <tr1/unordered_set>
+
+#include "worker-pool.h"
+#include "object-stream-writer.h"
+#include "incremental-writer.h"
+
+namespace
+{
+
+const PoDoFo::PdfName NONE_COLOR("None");
+const PoDoFo::PdfName ALL_COLOR("All");
+const PoDoFo::PdfName CYAN_COLOR("Cyan");
+const PoDoFo::PdfName MAGENTA_COLOR("Magenta");
+const PoDoFo::PdfName YELLOW_COLOR("Yellow");
+const PoDoFo::PdfName BLACK_COLOR("Black");
+const PoDoFo::PdfName SEPARATION_COLOR_SPACE("Separation");
+const PoDoFo::PdfName DEVICE_N_COLOR_SPACE("DeviceN");
+const PoDoFo::PdfName N_CHANNEL_COLOR_SPACE("NChannel");
+
+struct PdfReferenceHash
+// Hash function for using pdf references as unordered container keys
+{
+    size_t operator() ( const PoDoFo::PdfReference & ref ) const
+    {
+        return static_cast<size_t>( ref.ObjectNumber() ) * 65537
+               + ref.GenerationNumber();
+    }
+};
+
+typedef std::tr1::unordered_set<PoDoFo::PdfReference, PdfReferenceHash>
+        PdfReferenceSet;
+typedef std::tr1::unordered_map<PoDoFo::PdfReference, size_t,
+                                PdfReferenceHash> PdfReferenceIndex;
+
+struct ColorReferenceHash
+// Hash function for using color references as unordered container keys
+{
+    size_t operator() ( const ColorReference & ref ) const
+    {
+        size_t hash = PdfReferenceHash()( ref.object );
+        std::tr1::hash<std::string> nameHash;
+        for ( size_t i = 0; i < ref.path.size(); ++i )
+            hash = hash * 31 + nameHash( ref.path[i].GetName() );
+        return hash;
+    }
+};
+
+// Position of every color reference in the list of found ones
+typedef std::tr1::unordered_map<ColorReference, size_t, ColorReferenceHash>
+        ColorReferenceIndex;
+
+PoDoFo::PdfObject* GetColorArrayObject(
+                                const PoDoFo::PdfVecObjects & pdfDocObjects,
+                                const ColorReference & colorReference,
+                                PoDoFo::PdfObject* & indirectObject )
+// Returns object colorReference points to, NULL if there is none.
+// indirectObject is set to the object holding it.
+{
+    indirectObject = pdfDocObjects.GetObject( colorReference.object );
+    // Direct objects are found in place, dictionaries are not copied
+    PoDoFo::PdfObject* object = indirectObject;
+    for ( size_t i = 0; i < colorReference.path.size(); ++i )
+    {
+        if ( object == NULL || not object->IsDictionary() ) return NULL;
+        object = object->GetDictionary().GetKey( colorReference.path[i] );
+    }
+    return object;
+}
+
+struct Colorants
+// Colorant names of Separation, DeviceN or NChannel color array
+{
+    // Object to be marked changed when a name is replaced
+    PoDoFo::PdfObject* owner;
+    // Names are entries [first, end) of this array
+    PoDoFo::PdfArray* names;
+    size_t first;
+    size_t end;
+    bool deviceN;
+    // Alternate color space entry, NULL if missing
+    const PoDoFo::PdfObject* alternateSpace;
+};
+
+bool GetColorants( const PoDoFo::PdfVecObjects & pdfDocObjects,
+                   const ColorReference & colorReference,
+                   Colorants & colorants )
+// False if colorReference does not point to a spot color array
+{
+    PoDoFo::PdfObject* indirectObject;
+    PoDoFo::PdfObject* colorArrayObject = GetColorArrayObject( pdfDocObjects,
+                                            colorReference, indirectObject );
+    if ( colorArrayObject == NULL || not colorArrayObject->IsArray() )
+        return false;
+    PoDoFo::PdfArray & colorArray = colorArrayObject->GetArray();
+    if ( colorArray.GetSize() < 2 || not colorArray[0].IsName() )
+        return false;
+    const PoDoFo::PdfName & family = colorArray[0].GetName();
+    // Direct array is written as a part of the object holding it
+    colorants.owner = indirectObject;
+    colorants.alternateSpace = colorArray.GetSize() > 2 ? &colorArray[2]
+                                                        : NULL;
+    /* Color array for separation colorspace has 4 entries: 
+     * [ /Separation name alternateSpace tintTransform ]
+     * (see Pdf Reference, ch. 4.5.5)
+     */
+    if ( family == SEPARATION_COLOR_SPACE )
+    {
+        colorants.names = &colorArray;
+        colorants.first = 1;
+        colorants.end = 2;
+        colorants.deviceN = false;
+        return colorArray[1].IsName();
+    }
+    /* DeviceN color array has an array of colorant names instead:
+     * [ /DeviceN names alternateSpace tintTransform attributes ]
+     * NChannel is DeviceN with /Subtype /NChannel attributes,
+     * some producers write it as color space family as well.
+     */
+    if ( family != DEVICE_N_COLOR_SPACE && family != N_CHANNEL_COLOR_SPACE )
+        return false;
+    PoDoFo::PdfObject* namesObject = &colorArray[1];
+    if ( namesObject->IsReference() )
+    {
+        // Indirect names array is changed instead of the color array
+        namesObject = pdfDocObjects.GetObject( namesObject->GetReference() );
+        colorants.owner = namesObject;
+    }
+    if ( namesObject == NULL || not namesObject->IsArray() ) return false;
+    colorants.names = &namesObject->GetArray();
+    colorants.first = 0;
+    colorants.end = colorants.names->GetSize();
+    colorants.deviceN = true;
+    return true;
+}
+
+bool IsProcessColorant( const PoDoFo::PdfName & name )
+// True for names DeviceN arrays use for process colorants and /None
+// placeholders, which are not spots (see Pdf Reference, ch. 4.5.5)
+{
+    return name == NONE_COLOR || name == ALL_COLOR
+           || name == CYAN_COLOR || name == MAGENTA_COLOR
+           || name == YELLOW_COLOR || name == BLACK_COLOR;
+}
+
+bool IsSpotName( const Colorants & colorants, size_t index )
+// True if colorant index is a name which can be disabled. Process
+// colorants of DeviceN arrays like [ /Cyan /Magenta /Yellow /Black
+// /Spot ] are painted on process plates and are never disabled.
+{
+    const PoDoFo::PdfObject & name = (*colorants.names)[index];
+    return name.IsName()
+           && not ( colorants.deviceN && IsProcessColorant( name.GetName() ) );
+}
+
+std::string GetColorSpaceFamily( const PoDoFo::PdfVecObjects & pdfDocObjects,
+                                 const PoDoFo::PdfObject* colorSpace )
+// Family name of colorSpace, like DeviceCMYK for /DeviceCMYK
+// or ICCBased for [ /ICCBased stream ]. Empty if unknown.
+{
+    if ( colorSpace != NULL && colorSpace->IsReference() )
+        colorSpace = pdfDocObjects.GetObject( colorSpace->GetReference() );
+    if ( colorSpace == NULL ) return std::string();
+    if ( colorSpace->IsArray() && colorSpace->GetArray().GetSize() > 0 )
+        colorSpace = &colorSpace->GetArray()[0];
+    if ( not colorSpace->IsName() ) return std::string();
+    return colorSpace->GetName().GetName();
+}
+
+} // namespace
+
+namespace
+{
+
+const size_t NO_INDEX = static_cast<size_t>( -1 );
+
+struct ScanNode
+// Page or indirect object walked by page tracking scan
+{
+    ScanNode()
+        : order( NO_INDEX ),
+          lowLink( NO_INDEX ),
+          component( NO_INDEX ),
+          onStack( false )
+    {}
+
+    // Indexes of color references found in the object itself
+    std::vector<size_t> references;
+    // Nodes of indirect objects the object refers to
+    std::vector<size_t> children;
+    // Strongly connected component search, see GetReachableReferences()
+    size_t order;
+    size_t lowLink;
+    size_t component;
+    bool onStack;
+};
+
+struct ScanState
+// Results and memo of one page resources scan
+{
+    explicit ScanState( bool trackPages = false )
+        : trackPages( trackPages ),
+          currentNode( 0 ),
+          nodeCount( 0 )
+    {}
+
+    // Color array references in order of discovery, and their index
+    std::vector<ColorReference> colorReferences;
+    ColorReferenceIndex knownReferences;
+    // Indirect dictionaries and streams already walked
+    PdfReferenceSet visitedObjects;
+    // If set, referencePages[i] are indexes of pages using
+    // colorReferences[i], in ascending order
+    bool trackPages;
+    std::vector< std::vector<int> > referencePages;
+    /* Page tracking records which objects lead to which, so every object
+     * is still walked once and pages union color references reachable
+     * from them. References reachable from a node are memoized for its
+     * strongly connected component, cycles share one set.
+     */
+    std::vector<ScanNode> nodes;
+    PdfReferenceIndex objectNodes;
+    size_t currentNode;
+    size_t nodeCount;
+    std::vector< std::vector<size_t> > componentReferences;
+};
+
+size_t AddColorReference( const ColorReference & colorReference,
+                          const std::vector<int> & pages,
+                          ScanState & state )
+// Adds colorReference unless it is known and notes pages using it.
+// Returns its index in state.colorReferences.
+{
+    std::pair<ColorReferenceIndex::iterator, bool> inserted
+        = state.knownReferences.insert( std::make_pair( colorReference,
+                                            state.colorReferences.size() ) );
+    // If current reference is unique, add it to the vector
+    if ( inserted.second )
+    {
+        state.colorReferences.push_back( colorReference );
+        if ( state.trackPages )
+            state.referencePages.push_back( std::vector<int>() );
+    }
+    if ( not state.trackPages ) return inserted.first->second;
+    std::vector<int> & knownPages
+                            = state.referencePages[inserted.first->second];
+    for ( size_t i = 0; i < pages.size(); ++i )
+    {
+        if ( knownPages.empty() || knownPages.back() < pages[i] )
+            knownPages.push_back( pages[i] );
+    }
+    return inserted.first->second;
+}
+
+size_t GetNode( const PoDoFo::PdfReference & ref, ScanState & state )
+// Node of indirect object, created on first use
+{
+    std::pair<PdfReferenceIndex::iterator, bool> inserted
+        = state.objectNodes.insert( std::make_pair( ref,
+                                                    state.nodes.size() ) );
+    if ( inserted.second ) state.nodes.push_back( ScanNode() );
+    return inserted.first->second;
+}
+
+class NodeScope
+// Makes indirect object the current node of page tracking scan,
+// which gets color references and children found, until destroyed.
+// Direct objects belong to the node holding them.
+{
+public:
+    NodeScope( const PoDoFo::PdfObject* object, ScanState & state )
+        : state( state ),
+          previousNode( state.currentNode )
+    {
+        if ( state.trackPages && object->Reference().IsIndirect() )
+            state.currentNode = GetNode( object->Reference(), state );
+    }
+
+    ~NodeScope() { state.currentNode = previousNode; }
+
+private:
+    ScanState & state;
+    size_t previousNode;
+
+    NodeScope( const NodeScope & );
+    NodeScope & operator= ( const NodeScope & );
+};
+
+const std::vector<size_t> & GetReachableReferences( size_t root,
+                                                    ScanState & state )
+// Sorted indexes of color references reachable from node root. Strongly
+// connected components are found by Tarjan's algorithm, which completes
+// a component after all components reachable from it, so its set is
+// a union of the sets of its members and of already completed ones.
+// Nodes must not get children after their component is completed.
+{
+    std::vector<ScanNode> & nodes = state.nodes;
+    if ( nodes[root].component != NO_INDEX )
+        return state.componentReferences[nodes[root].component];
+
+    // Depth-first path as node and its next child, without recursion,
+    // so that deeply nested forms can not exhaust the stack
+    std::vector< std::pair<size_t, size_t> > path;
+    std::vector<size_t> stack;
+    path.push_back( std::make_pair( root, 0 ) );
+    nodes[root].order = nodes[root].lowLink = state.nodeCount++;
+    nodes[root].onStack = true;
+    stack.push_back( root );
+    while ( not path.empty() )
+    {
+        size_t node = path.back().first;
+        if ( path.back().second < nodes[node].children.size() )
+        {
+            size_t child = nodes[node].children[path.back().second++];
+            if ( nodes[child].order == NO_INDEX )
+            {
+                nodes[child].order = nodes[child].lowLink
+                                   = state.nodeCount++;
+                nodes[child].onStack = true;
+                stack.push_back( child );
+                path.push_back( std::make_pair( child, 0 ) );
+            }
+            else if ( nodes[child].onStack )
+            {
+                nodes[node].lowLink = std::min( nodes[node].lowLink,
+                                                nodes[child].order );
+            }
+            continue;
+        }
+        path.pop_back();
+        if ( not path.empty() )
+        {
+            ScanNode & parent = nodes[path.back().first];
+            parent.lowLink = std::min( parent.lowLink, nodes[node].lowLink );
+        }
+        if ( nodes[node].lowLink != nodes[node].order ) continue;
+
+        // Node is the first of its component, members are above it
+        size_t component = state.componentReferences.size();
+        std::vector<size_t> members;
+        do
+        {
+            members.push_back( stack.back() );
+            stack.pop_back();
+            nodes[members.back()].onStack = false;
+            nodes[members.back()].component = component;
+        }
+        while ( members.back() != node );
+
+        std::vector<size_t> references;
+        for ( size_t i = 0; i < members.size(); ++i )
+        {
+            const ScanNode & member = nodes[members[i]];
+            references.insert( references.end(), member.references.begin(),
+                               member.references.end() );
+            for ( size_t j = 0; j < member.children.size(); ++j )
+            {
+                size_t childComponent = nodes[member.children[j]].component;
+                if ( childComponent == component ) continue;
+                const std::vector<size_t> & reachable
+                            = state.componentReferences[childComponent];
+                references.insert( references.end(), reachable.begin(),
+                                   reachable.end() );
+            }
+        }
+        std::sort( references.begin(), references.end() );
+        references.erase( std::unique( references.begin(), references.end() ),
+                          references.end() );
+        state.componentReferences.push_back( std::vector<size_t>() );
+        state.componentReferences.back().swap( references );
+    }
+    return state.componentReferences[nodes[root].component];
+}
+
+struct PendingResources
+// Resource dictionary waiting to be walked, where it is found
+// and the node of page tracking scan leading to it
+{
+    const PoDoFo::PdfObject* resources;
+    ColorReference location;
+    size_t node;
+};
+
+const PoDoFo::PdfName COLOR_SPACE_KEY("ColorSpace");
+const PoDoFo::PdfName RESOURCES_KEY("Resources");
+const PoDoFo::PdfName SUBTYPE_KEY("Subtype");
+const PoDoFo::PdfName FORM_SUBTYPE("Form");
+// Deeper page trees are taken for /Parent loops
+const int MAX_PAGE_TREE_DEPTH = 256;
+
+bool IsVisited( const PoDoFo::PdfObject* object, ScanState & state )
+// True if indirect object was walked already, marks it walked otherwise.
+// Direct objects are never shared, so they are never visited.
+// Page tracking scan links the object to the current node either way.
+{
+    const PoDoFo::PdfReference & ref = object->Reference();
+    if ( not ref.IsIndirect() ) return false;
+    if ( state.trackPages )
+    {
+        size_t node = GetNode( ref, state );
+        state.nodes[state.currentNode].children.push_back( node );
+    }
+    return not state.visitedObjects.insert( ref ).second;
+}
+
+const PoDoFo::PdfObject* Dereference(
+                                const PoDoFo::PdfMemDocument & pdfDocument,
+                                const PoDoFo::PdfObject* object )
+// Returns object pointed to by reference object, or object itself
+{
+    if ( object != NULL && object->IsReference() )
+        return pdfDocument.GetObjects().GetObject( object->GetReference() );
+    return object;
+}
+
+const PoDoFo::PdfObject* GetDictionaryKey(
+                                const PoDoFo::PdfMemDocument & pdfDocument,
+                                const PoDoFo::PdfObject* object,
+                                const PoDoFo::PdfName & key )
+// Dereferenced value of key if object is a dictionary, otherwise NULL
+{
+    if ( object == NULL || not object->IsDictionary() ) return NULL;
+    return Dereference( pdfDocument, object->GetDictionary().GetKey( key ) );
+}
+
+ColorReference Locate( const PoDoFo::PdfObject* object,
+                       const ColorReference & parent,
+                       const PoDoFo::PdfName & key )
+// Where dereferenced object found under key of parent dictionary lives
+{
+    if ( object->Reference().IsIndirect() )
+        return ColorReference( object->Reference() );
+    ColorReference location = parent;
+    location.path.push_back( key );
+    return location;
+}
+
+void AddColorSpace( const PoDoFo::PdfObject* dictionary,
+                    const ColorReference & location,
+                    const PoDoFo::PdfName & key,
+                    ScanState & state )
+// Remembers color array under key of dictionary found at location
+{
+    const PoDoFo::PdfObject* colorSpace = dictionary->GetDictionary()
+                                                    .GetKey( key );
+    ColorReference colorReference;
+    /* Reference points to array with actual values of color entry,
+     * but many producers write the array right into the dictionary.
+     * Names like /DeviceRGB have no spots.
+     */
+    if ( colorSpace != NULL && colorSpace->IsReference() )
+        colorReference = ColorReference( colorSpace->GetReference() );
+    else if ( colorSpace != NULL && colorSpace->IsArray() )
+        colorReference = Locate( colorSpace, location, key );
+    else
+        return;
+    size_t index = AddColorReference( colorReference, std::vector<int>(),
+                                      state );
+    if ( state.trackPages )
+        state.nodes[state.currentNode].references.push_back( index );
+}
+
+void AddForm( const PoDoFo::PdfMemDocument & pdfDocument,
+              const PoDoFo::PdfObject* form,
+              const ColorReference & location,
+              ScanState & state,
+              std::deque<PendingResources> & pendingResources )
+// Queues resources of form XObject or tiling pattern not walked yet
+{
+    if ( form == NULL || not form->IsDictionary() || IsVisited( form, state ) )
+        return;
+    const PoDoFo::PdfObject* resources = GetDictionaryKey( pdfDocument, form,
+                                                           RESOURCES_KEY );
+    if ( resources == NULL ) return;
+    NodeScope scope( form, state );
+    PendingResources pending = { resources,
+                                 Locate( resources, location, RESOURCES_KEY ),
+                                 state.currentNode };
+    pendingResources.push_back( pending );
+}
+
+void AddShading( const PoDoFo::PdfObject* shading,
+                 const ColorReference & location,
+                 ScanState & state )
+// Remembers color space of shading dictionary or stream
+{
+    if ( shading == NULL || not shading->IsDictionary()
+         || IsVisited( shading, state ) )
+        return;
+    NodeScope scope( shading, state );
+    AddColorSpace( shading, location, COLOR_SPACE_KEY, state );
+}
+
+void ScanResources( const PoDoFo::PdfMemDocument & pdfDocument,
+                    const PendingResources & pending,
+                    ScanState & state,
+                    std::deque<PendingResources> & pendingResources )
+// Collects color spaces of resource dictionary and queues resources
+// of forms and patterns it refers to
+{
+    const PoDoFo::PdfObject* resources = pending.resources;
+    /* Resources are often shared by all pages, e.g. inherited from
+     * the /Pages node, or by many forms, so each is walked only once.
+     */
+    if ( resources == NULL || not resources->IsDictionary()
+         || IsVisited( resources, state ) )
+        return;
+    NodeScope scope( resources, state );
+
+    /* The ColorSpace subdictionary entries are like "Name : Reference"
+     * or "Name : Array". "Name" is something like CS11, CS24.
+     */
+    const PoDoFo::PdfObject* colorSpaces = GetDictionaryKey( pdfDocument,
+                                                resources, COLOR_SPACE_KEY );
+    if ( colorSpaces != NULL && colorSpaces->IsDictionary()
+         && not IsVisited( colorSpaces, state ) )
+    {
+        NodeScope colorSpacesScope( colorSpaces, state );
+        ColorReference location = Locate( colorSpaces, pending.location,
+                                           COLOR_SPACE_KEY );
+        const PoDoFo::TKeyMap & keys = colorSpaces->GetDictionary().GetKeys();
+        PoDoFo::TKeyMap::const_iterator it;
+        for ( it = keys.begin(); it != keys.end(); ++it )
+            AddColorSpace( colorSpaces, location, it->first, state );
+    }
+
+    // Form XObjects have resources of their own, images only color space
+    const PoDoFo::PdfObject* xObjects = GetDictionaryKey( pdfDocument,
+                                                resources, "XObject" );
+    if ( xObjects != NULL && xObjects->IsDictionary()
+         && not IsVisited( xObjects, state ) )
+    {
+        NodeScope xObjectsScope( xObjects, state );
+        ColorReference location = Locate( xObjects, pending.location,
+                                          "XObject" );
+        const PoDoFo::TKeyMap & keys = xObjects->GetDictionary().GetKeys();
+        PoDoFo::TKeyMap::const_iterator it;
+        for ( it = keys.begin(); it != keys.end(); ++it )
+        {
+            const PoDoFo::PdfObject* xObject = Dereference( pdfDocument,
+                                                            it->second );
+            if ( xObject == NULL || not xObject->IsDictionary() ) continue;
+            const PoDoFo::PdfObject* subtype = GetDictionaryKey( pdfDocument,
+                                                    xObject, SUBTYPE_KEY );
+            if ( subtype != NULL && subtype->IsName()
+                 && subtype->GetName() == FORM_SUBTYPE )
+            {
+                AddForm( pdfDocument, xObject,
+                         Locate( xObject, location, it->first ),
+                         state, pendingResources );
+            }
+            else
+            {
+                AddColorSpace( xObject, Locate( xObject, location, it->first ),
+                               COLOR_SPACE_KEY, state );
+            }
+        }
+    }
+
+    // Tiling patterns have resources, shading patterns have a shading
+    const PoDoFo::PdfObject* patterns = GetDictionaryKey( pdfDocument,
+                                                resources, "Pattern" );
+    if ( patterns != NULL && patterns->IsDictionary()
+         && not IsVisited( patterns, state ) )
+    {
+        NodeScope patternsScope( patterns, state );
+        ColorReference location = Locate( patterns, pending.location,
+                                          "Pattern" );
+        const PoDoFo::TKeyMap & keys = patterns->GetDictionary().GetKeys();
+        PoDoFo::TKeyMap::const_iterator it;
+        for ( it = keys.begin(); it != keys.end(); ++it )
+        {
+            const PoDoFo::PdfObject* pattern = Dereference( pdfDocument,
+                                                            it->second );
+            if ( pattern == NULL ) continue;
+            ColorReference patternLocation = Locate( pattern, location,
+                                                     it->first );
+            const PoDoFo::PdfObject* shading = GetDictionaryKey( pdfDocument,
+                                                    pattern, "Shading" );
+            if ( shading != NULL )
+                AddShading( shading,
+                            Locate( shading, patternLocation, "Shading" ),
+                            state );
+            else
+                AddForm( pdfDocument, pattern, patternLocation, state,
+                         pendingResources );
+        }
+    }
+
+    const PoDoFo::PdfObject* shadings = GetDictionaryKey( pdfDocument,
+                                                resources, "Shading" );
+    if ( shadings != NULL && shadings->IsDictionary()
+         && not IsVisited( shadings, state ) )
+    {
+        NodeScope shadingsScope( shadings, state );
+        ColorReference location = Locate( shadings, pending.location,
+                                          "Shading" );
+        const PoDoFo::TKeyMap & keys = shadings->GetDictionary().GetKeys();
+        PoDoFo::TKeyMap::const_iterator it;
+        for ( it = keys.begin(); it != keys.end(); ++it )
+        {
+            const PoDoFo::PdfObject* shading = Dereference( pdfDocument,
+                                                            it->second );
+            if ( shading != NULL )
+                AddShading( shading, Locate( shading, location, it->first ),
+                            state );
+        }
+    }
+}
+
+void AddAnnotations( const PoDoFo::PdfMemDocument & pdfDocument,
+                     const PoDoFo::PdfObject* pageObject,
+                     ScanState & state,
+                     std::deque<PendingResources> & pendingResources )
+// Queues resources of page annotation appearance streams
+{
+    const PoDoFo::PdfObject* annotations = GetDictionaryKey( pdfDocument,
+                                                pageObject, "Annots" );
+    if ( annotations == NULL || not annotations->IsArray() ) return;
+    const PoDoFo::PdfArray & annotationArray = annotations->GetArray();
+    for ( size_t i = 0; i < annotationArray.GetSize(); ++i )
+    {
+        const PoDoFo::PdfObject* annotation = Dereference( pdfDocument,
+                                                    &annotationArray[i] );
+        if ( annotation == NULL || IsVisited( annotation, state ) ) continue;
+        NodeScope scope( annotation, state );
+        const PoDoFo::PdfObject* appearances = GetDictionaryKey( pdfDocument,
+                                                    annotation, "AP" );
+        if ( appearances == NULL || not appearances->IsDictionary() )
+            continue;
+        /* Appearances are streams, so they are always indirect and
+         * their resources are located from them. Array items have
+         * no key, annotation itself is located only if indirect.
+         */
+        const ColorReference annotationLocation( annotation->Reference() );
+        ColorReference location = Locate( appearances, annotationLocation,
+                                          "AP" );
+        /* Normal, rollover and down appearances (see Pdf Reference,
+         * ch. 8.4.4) are either a form or a dictionary of forms
+         * for annotation states like /On and /Off.
+         */
+        const PoDoFo::TKeyMap & keys = appearances->GetDictionary().GetKeys();
+        PoDoFo::TKeyMap::const_iterator it;
+        for ( it = keys.begin(); it != keys.end(); ++it )
+        {
+            const PoDoFo::PdfObject* appearance = Dereference( pdfDocument,
+                                                               it->second );
+            if ( appearance == NULL || not appearance->IsDictionary() )
+                continue;
+            ColorReference appearanceLocation = Locate( appearance, location,
+                                                        it->first );
+            // Forms must have bounding box, state dictionaries never do
+            if ( appearance->GetDictionary().HasKey( "BBox" ) )
+            {
+                AddForm( pdfDocument, appearance, appearanceLocation, state,
+                         pendingResources );
+                continue;
+            }
+            const PoDoFo::TKeyMap & states
+                                    = appearance->GetDictionary().GetKeys();
+            PoDoFo::TKeyMap::const_iterator stateIt;
+            for ( stateIt = states.begin(); stateIt != states.end(); ++stateIt )
+            {
+                const PoDoFo::PdfObject* form = Dereference( pdfDocument,
+                                                        stateIt->second );
+                if ( form != NULL )
+                    AddForm( pdfDocument, form,
+                             Locate( form, appearanceLocation, stateIt->first ),
+                             state, pendingResources );
+            }
+        }
+    }
+}
+
+PendingResources GetPageResources( const PoDoFo::PdfMemDocument & pdfDocument,
+                                   const PoDoFo::PdfObject* pageObject )
+// Resources of page, which may be inherited from page tree nodes
+{
+    PendingResources pending = { NULL, ColorReference(), 0 };
+    const PoDoFo::PdfObject* node = pageObject;
+    for ( int depth = 0; node != NULL && depth < MAX_PAGE_TREE_DEPTH; ++depth )
+    {
+        const PoDoFo::PdfObject* resources = GetDictionaryKey( pdfDocument,
+                                                    node, RESOURCES_KEY );
+        if ( resources != NULL )
+        {
+            // Page tree nodes are always indirect
+            pending.resources = resources;
+            pending.location = Locate( resources,
+                                       ColorReference( node->Reference() ),
+                                       RESOURCES_KEY );
+            break;
+        }
+        node = GetDictionaryKey( pdfDocument, node, "Parent" );
+    }
+    return pending;
+}
+
+void CollectColorReferences( const PoDoFo::PdfMemDocument & pdfDocument,
+                             int firstPage, int endPage,
+                             ScanState & state )
+// Adds references to color arrays used by pages [firstPage, endPage)
+// to state. Walks page resources, nested form XObjects, patterns,
+// shadings and annotation appearances. Indirect objects walked already
+// are skipped, so shared forms are scanned once and cycles end.
+// Pages using shared objects are found from memoized page tracking nodes.
+{
+    // Resource dictionaries waiting to be walked, in order of discovery
+    std::deque<PendingResources> pendingResources;
+    // Iterate over each page of pdf document
+    for ( int pn = firstPage; pn < endPage; ++pn )
+    {
+        PoDoFo::PdfPage* page = pdfDocument.GetPage(pn);
+        // If something wrong with this page - just continue with next
+        if ( page == NULL ) continue;
+        NodeScope pageScope( page->GetObject(), state );
+        PendingResources pageResources = GetPageResources( pdfDocument,
+                                                    page->GetObject() );
+        pageResources.node = state.currentNode;
+        pendingResources.push_back( pageResources );
+        AddAnnotations( pdfDocument, page->GetObject(), state,
+                        pendingResources );
+        // Nested resources are queued instead of recursion,
+        // so deeply nested forms can not exhaust the stack
+        while ( not pendingResources.empty() )
+        {
+            state.currentNode = pendingResources.front().node;
+            ScanResources( pdfDocument, pendingResources.front(), state,
+                           pendingResources );
+            pendingResources.pop_front();
+        }
+        if ( not state.trackPages ) continue;
+
+        /* Everything reachable from the page is walked by now, also
+         * when walked for earlier pages, so its references are final
+         */
+        const std::vector<size_t> & references = GetReachableReferences(
+                                    pageResources.node, state );
+        for ( size_t i = 0; i < references.size(); ++i )
+        {
+            std::vector<int> & pages = state.referencePages[references[i]];
+            if ( pages.empty() || pages.back() < pn ) pages.push_back( pn );
+        }
+    } // Current Page processing
+}
+
+// Smaller page ranges do not pay for loading one more document copy
+const int MIN_PAGES_PER_THREAD = 256;
+// Copies of the document loaded for page ranges take memory and xref
+// parsing time growing with input size, so together they may not take
+// more than this size of input
+const unsigned long long MAX_COPIED_INPUT_SIZE = 256 * 1024 * 1024;
+
+class PageScanTask : public WorkerTask
+// Collects color references of a page range. Scans pdfDocument if given,
+// otherwise loads its own copy of the document from source.
+{
+public:
+    PageScanTask( const PoDoFo::PdfMemDocument* pdfDocument,
+                  const PdfSource & source, int firstPage, int endPage,
+                  bool trackPages )
+        : pdfDocument( pdfDocument ),
+          source( source ),
+          firstPage( firstPage ),
+          endPage( endPage ),
+          succeeded( false ),
+          cpuSeconds( 0 ),
+          state( trackPages )
+    {}
+
+    void Run()
+    {
+        const double cpuStart = GetThreadCpuTime();
+        Scan();
+        cpuSeconds = GetThreadCpuTime() - cpuStart;
+    }
+
+    int GetFirstPage() const { return firstPage; }
+    int GetEndPage() const { return endPage; }
+    bool IsSucceeded() const { return succeeded; }
+    double GetCpuSeconds() const { return cpuSeconds; }
+    const std::vector<ColorReference> & GetColorReferences() const
+    {
+        return state.colorReferences;
+    }
+    const std::vector< std::vector<int> > & GetReferencePages() const
+    {
+        return state.referencePages;
+    }
+
+private:
+    void Scan()
+    {
+        // Failed range is scanned again by the calling thread,
+        // which reports the error if it is real
+        try
+        {
+            MemoryStreamBuffer dataBuffer( source.data, source.size );
+            std::istream dataStream( &dataBuffer );
+            PoDoFo::PdfMemDocument pdfCopy;
+            if ( pdfDocument == NULL )
+            {
+                if ( source.data != NULL )
+                    pdfCopy.Load( PoDoFo::PdfRefCountedInputDevice(
+                            new PoDoFo::PdfInputDevice( &dataStream ) ) );
+                else
+                    pdfCopy.Load( source.fileName.c_str() );
+            }
+            CollectColorReferences( pdfDocument != NULL ? *pdfDocument
+                                                        : pdfCopy,
+                                    firstPage, endPage, state );
+            succeeded = true;
+        }
+        catch ( ... )
+        {
+            state.colorReferences.clear();
+        }
+    }
+
+    const PoDoFo::PdfMemDocument* pdfDocument;
+    const PdfSource & source;
+    int firstPage;
+    int endPage;
+    bool succeeded;
+    double cpuSeconds;
+    // Thread local results, merged by the calling thread
+    ScanState state;
+};
+
+} // namespace
+
+std::vector<ColorReference> GetColorReferences( 
+                                    const PoDoFo::PdfMemDocument & pdfDocument )
+// Returns a vector with references to color decryption arrays in pdf document
+{
+    ScanState state;
+    CollectColorReferences( pdfDocument, 0, pdfDocument.GetPageCount(),
+                            state );
+    return state.colorReferences;
+}
+
+std::vector<ColorReference> GetColorReferences(
+                        const PoDoFo::PdfMemDocument & pdfDocument,
+                        const PdfSource & source,
+                        unsigned int threadCount,
+                        std::vector< std::vector<int> >* referencePages )
+{
+    int pageCount = pdfDocument.GetPageCount();
+    int rangeCount = std::min<int>( threadCount,
+                                    pageCount / MIN_PAGES_PER_THREAD );
+    const unsigned long long inputSize = source.data != NULL
+                                ? source.size
+                                : GetFileSize( source.fileName.c_str() );
+    if ( rangeCount > 1 && inputSize > 0 )
+        rangeCount = static_cast<int>( std::min<unsigned long long>(
+                        rangeCount, 1 + MAX_COPIED_INPUT_SIZE / inputSize ) );
+    bool trackPages = referencePages != NULL;
+    if ( rangeCount < 2 )
+    {
+        ScanState state( trackPages );
+        CollectColorReferences( pdfDocument, 0, pageCount, state );
+        if ( trackPages ) referencePages->swap( state.referencePages );
+        return state.colorReferences;
+    }
+
+    // The first range is scanned on the already loaded document
+    std::vector<PageScanTask*> tasks;
+    for ( int i = 0; i < rangeCount; ++i )
+        tasks.push_back( new PageScanTask( i == 0 ? &pdfDocument : NULL,
+                                           source,
+                                           pageCount * i / rangeCount,
+                                           pageCount * ( i + 1 ) / rangeCount,
+                                           trackPages ) );
+    {
+        WorkerPool pool( rangeCount );
+        for ( size_t i = 0; i < tasks.size(); ++i )
+            pool.Add( tasks[i] );
+        pool.Wait();
+    }
+
+    // Merging ranges in page order gives exactly the serial scan result
+    ScanState state( trackPages );
+    for ( size_t i = 0; i < tasks.size(); ++i )
+    {
+        AddWorkerCpuTime( tasks[i]->GetCpuSeconds() );
+        if ( tasks[i]->IsSucceeded() )
+        {
+            const std::vector<ColorReference> & rangeReferences
+                                            = tasks[i]->GetColorReferences();
+            const std::vector<int> noPages;
+            for ( size_t j = 0; j < rangeReferences.size(); ++j )
+                AddColorReference( rangeReferences[j],
+                                   trackPages
+                                       ? tasks[i]->GetReferencePages()[j]
+                                       : noPages,
+                                   state );
+        }
+        else
+        {
+            CollectColorReferences( pdfDocument, tasks[i]->GetFirstPage(),
+                                    tasks[i]->GetEndPage(), state );
+        }
+        delete tasks[i];
+    }
+    if ( trackPages ) referencePages->swap( state.referencePages );
+    return state.colorReferences;
+}
+
+std::vector<std::string> ListAvailableSpots(
+                    const PoDoFo::PdfMemDocument & pdfDocument,
+                    const std::vector<ColorReference> & colorReferences,
+                    RunStats & stats )
+// Returns pdf document spot names
+{
+    std::vector<std::string> spotNames;
+    const PoDoFo::PdfVecObjects & pdfDocObjects = pdfDocument.GetObjects();
+    Colorants colorants;
+    std::vector<ColorReference>::const_iterator it;
+    for ( it = colorReferences.begin(); it != colorReferences.end(); ++it )
+    {
+        // Obtaining color array by reference
+        if ( not GetColorants( pdfDocObjects, *it, colorants ) ) continue;
+        ++( colorants.deviceN ? stats.deviceNArrays
+                              : stats.separationArrays );
+        for ( size_t i = colorants.first; i < colorants.end; ++i )
+        {
+            /* In pdf's spot names spaces and other special characters
+             * are escaped like "#20". PdfName keeps the decoded name.
+             */
+            if ( IsSpotName( colorants, i ) )
+                spotNames.push_back( (*colorants.names)[i].GetName()
+                                                          .GetName() );
+        }
+    } // Iterating through color references
+    return spotNames;
+}
+
+std::vector<SpotUsage> GetSpotUsage(
+                    const PoDoFo::PdfMemDocument & pdfDocument,
+                    const std::vector<ColorReference> & colorReferences,
+                    const std::vector< std::vector<int> > & referencePages,
+                    RunStats & stats )
+// Same walk as ListAvailableSpots(), with arrays grouped by spot name
+{
+    std::vector<SpotUsage> spots;
+    std::tr1::unordered_map<std::string, size_t> spotIndex;
+    const PoDoFo::PdfVecObjects & pdfDocObjects = pdfDocument.GetObjects();
+    Colorants colorants;
+    for ( size_t r = 0; r < colorReferences.size(); ++r )
+    {
+        if ( not GetColorants( pdfDocObjects, colorReferences[r], colorants ) )
+            continue;
+        ++( colorants.deviceN ? stats.deviceNArrays
+                              : stats.separationArrays );
+        for ( size_t i = colorants.first; i < colorants.end; ++i )
+        {
+            if ( not IsSpotName( colorants, i ) ) continue;
+            const std::string & name = (*colorants.names)[i].GetName()
+                                                              .GetName();
+            std::pair<std::tr1::unordered_map<std::string, size_t>::iterator,
+                      bool> inserted
+                = spotIndex.insert( std::make_pair( name, spots.size() ) );
+            if ( inserted.second )
+            {
+                spots.push_back( SpotUsage() );
+                spots.back().name = name;
+                spots.back().alternateSpace = GetColorSpaceFamily(
+                                pdfDocObjects, colorants.alternateSpace );
+            }
+            SpotUsage & spot = spots[inserted.first->second];
+            ++spot.colorSpaceCount;
+            if ( r < referencePages.size() )
+                spot.pages.insert( spot.pages.end(),
+                                   referencePages[r].begin(),
+                                   referencePages[r].end() );
+        }
+    } // Iterating through color references
+
+    // Page lists of different arrays overlap, page numbers start from 1
+    for ( size_t i = 0; i < spots.size(); ++i )
+    {
+        std::vector<int> & pages = spots[i].pages;
+        std::sort( pages.begin(), pages.end() );
+        pages.erase( std::unique( pages.begin(), pages.end() ), pages.end() );
+        for ( size_t j = 0; j < pages.size(); ++j )
+            ++pages[j];
+    }
+    return spots;
+}
+
+bool MustBeDisabled( const std::string & spotName,
+                     const SpotMatcher & spotsToDisable )
+{
+    // Matcher ignores case of spot names
+    return spotsToDisable.Matches( spotName );
+}
+
+SpotDecisions::SpotDecisions( const SpotMatcher & spotsToDisable )
+    : spotsToDisable( spotsToDisable ),
+      lookupCount( 0 ),
+      hitCount( 0 )
+{
+    pthread_mutex_init( &mutex, NULL );
+}
+
+SpotDecisions::~SpotDecisions()
+{
+    pthread_mutex_destroy( &mutex );
+}
+
+bool SpotDecisions::MustBeDisabled( const std::string & spotName )
+{
+    MutexLock lock( mutex );
+    ++lookupCount;
+    std::tr1::unordered_map<std::string, bool>::const_iterator it
+                                        = decisions.find( spotName );
+    if ( it != decisions.end() )
+    {
+        ++hitCount;
+        return it->second;
+    }
+    bool decision = ::MustBeDisabled( spotName, spotsToDisable );
+    decisions.insert( std::make_pair( spotName, decision ) );
+    return decision;
+}
+
+void DisableSpots( PoDoFo::PdfMemDocument & pdfDocument,
+                   const std::vector<ColorReference> & colorReferences,
+                   SpotDecisions & spotsToDisable,
+                   RunStats & stats,
+                   std::vector<DisabledSpot> & disabledSpots )
+// Replaces names of spots from spotsToDisable list with /None.
+// Every name is appended to disabledSpots before it is replaced, so that
+// changes can be undone even if an exception stops the rewrite.
+{
+    // Objects are changed in place, right in the document's object store.
+    PoDoFo::PdfVecObjects & pdfDocObjects = pdfDocument.GetObjects();
+    Colorants colorants;
+    std::vector<ColorReference>::const_iterator it;
+    for ( it = colorReferences.begin(); it != colorReferences.end(); ++it )
+    {
+        // Obtaining color array by reference
+        if ( not GetColorants( pdfDocObjects, *it, colorants ) ) continue;
+        ++( colorants.deviceN ? stats.deviceNArrays
+                              : stats.separationArrays );
+        /* If colorant name would be replaced with special name /None,
+         * the colorant is never painted (see Pdf Reference, ch. 4.5.5),
+         * so all objects using this spot become invisible.
+         */
+        for ( size_t i = colorants.first; i < colorants.end; ++i )
+        {
+            PoDoFo::PdfObject & name = (*colorants.names)[i];
+            if ( IsSpotName( colorants, i )
+                 && spotsToDisable.MustBeDisabled( name.GetName().GetName() ) )
+            {
+                DisabledSpot disabledSpot = { colorants.owner, colorants.names,
+                                              i, name.GetName() };
+                disabledSpots.push_back( disabledSpot );
+                name = NONE_COLOR;
+                ++stats.disabledSpots;
+            }
+        }
+    } // Iterating through color references
+}
+
+void RestoreSpots( const std::vector<DisabledSpot> & disabledSpots )
+// Puts back spot names replaced by DisableSpots()
+{
+    std::vector<DisabledSpot>::const_iterator it;
+    for ( it = disabledSpots.begin(); it != disabledSpots.end(); ++it )
+    {
+        (*it->names)[it->index] = it->spotName;
+    }
+}
+
+unsigned long long WriteDocument( PoDoFo::PdfMemDocument & pdfDocument,
+                            const PdfSource & source,
+                            const std::vector<DisabledSpot> & disabledSpots,
+                            PoDoFo::PdfOutputDevice & outputDevice,
+                            const OutputOptions & outputOptions )
+{
+    /* Streams are never decoded here: PoDoFo keeps parsed stream data
+     * in its original filtered form and writes it back byte for byte.
+     */
+    if ( outputOptions.incremental )
+    {
+        // Objects holding the replaced names are the only changed ones
+        std::vector<const PoDoFo::PdfObject*> changedObjects;
+        for ( size_t i = 0; i < disabledSpots.size(); ++i )
+            changedObjects.push_back( disabledSpots[i].changedObject );
+        return WriteIncremental( pdfDocument, source, changedObjects,
+                                 outputDevice );
+    }
+    else if ( outputOptions.compressed )
+    {
+        return WriteCompressed( pdfDocument, outputDevice,
+                                outputOptions.threadCount );
+    }
+    else
+    {
+        pdfDocument.Write( &outputDevice );
+    }
+    outputDevice.Flush();
+    return outputDevice.GetLength();
+}
+
+MemoryStreamBuffer::MemoryStreamBuffer( const char* data, size_t size )
+{
+    // Get area is never written to
+    char* begin = const_cast<char*>( data );
+    setg( begin, begin, begin + size );
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekoff( off_type offset,
+                                        std::ios_base::seekdir direction,
+                                        std::ios_base::openmode mode )
+{
+    if ( mode & std::ios_base::out ) return pos_type( off_type( -1 ) );
+    off_type base = 0;
+    if ( direction == std::ios_base::cur ) base = gptr() - eback();
+    else if ( direction == std::ios_base::end ) base = egptr() - eback();
+    off_type position = base + offset;
+    if ( position < 0 || position > egptr() - eback() )
+        return pos_type( off_type( -1 ) );
+    setg( eback(), eback() + position, egptr() );
+    return pos_type( position );
+}
+
+MemoryStreamBuffer::pos_type MemoryStreamBuffer::seekpos( pos_type position,
+                                        std::ios_base::openmode mode )
+{
+    return seekoff( off_type( position ), std::ios_base::beg, mode );
+}
+
+SpotDisabler::SpotDisabler( const char* data, size_t size )
+    : dataBuffer( data, size ),
+      dataStream( &dataBuffer ),
+      source( data, size ),
+      threadCount( 1 ),
+      scanned( false )
+{
+    PhaseTimer timer( stats, RunStats::PHASE_LOAD );
+    ++stats.files;
+    stats.inputBytes += size;
+    // Input device owned by the parser reads the buffer in place
+    pdfDocument.Load( PoDoFo::PdfRefCountedInputDevice(
+                            new PoDoFo::PdfInputDevice( &dataStream ) ) );
+}
+
+const std::vector<ColorReference> & SpotDisabler::GetColorReferences()
+// Scans pages once, the result is shared by all calls
+{
+    if ( not scanned )
+    {
+        PhaseTimer timer( stats, RunStats::PHASE_SCAN );
+        colorReferences = ::GetColorReferences( pdfDocument, source,
+                                                threadCount );
+        stats.pages += pdfDocument.GetPageCount();
+        stats.colorReferences += colorReferences.size();
+        scanned = true;
+    }
+    return colorReferences;
+}
+
+std::vector<std::string> SpotDisabler::ListSpots()
+{
+    const std::vector<ColorReference> & references
+                                                = GetColorReferences();
+    PhaseTimer timer( stats, RunStats::PHASE_SCAN );
+    return ListAvailableSpots( pdfDocument, references, stats );
+}
+
+unsigned long SpotDisabler::DisableSpots( SpotDecisions & spotsToDisable )
+{
+    const std::vector<ColorReference> & references
+                                                = GetColorReferences();
+    PhaseTimer timer( stats, RunStats::PHASE_REWRITE );
+    const size_t disabledBefore = disabledSpots.size();
+    ::DisableSpots( pdfDocument, references, spotsToDisable, stats,
+                    disabledSpots );
+    return disabledSpots.size() - disabledBefore;
+}
+
+unsigned long SpotDisabler::DisableSpots(
+                                const std::vector<std::string> & spotNames )
+{
+    const SpotMatcher spotMatcher( spotNames );
+    SpotDecisions spotsToDisable( spotMatcher );
+    unsigned long disabledCount = DisableSpots( spotsToDisable );
+    stats.spotCacheLookups += spotsToDisable.GetLookupCount();
+    stats.spotCacheHits += spotsToDisable.GetHitCount();
+    return disabledCount;
+}
+
+void SpotDisabler::RestoreSpots()
+{
+    // Latest changes are undone first
+    std::vector<DisabledSpot> undoOrder( disabledSpots.rbegin(),
+                                         disabledSpots.rend() );
+    ::RestoreSpots( undoOrder );
+    disabledSpots.clear();
+}
+
+void SpotDisabler::SetThreadCount( unsigned int threadCount )
+{
+    this->threadCount = std::max( threadCount, 1u );
+}
+
+unsigned long long SpotDisabler::Write( std::ostream & output,
+                                        const OutputOptions & outputOptions )
+{
+    PhaseTimer timer( stats, RunStats::PHASE_WRITE );
+    PoDoFo::PdfOutputDevice outputDevice( &output );
+    unsigned long long size = WriteDocument( pdfDocument, source,
+                                             disabledSpots, outputDevice,
+                                             outputOptions );
+    stats.outputBytes += size;
+    return size;
+}
@@ -0,0 +1,274 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef SPOT_DISABLER_H
+#define SPOT_DISABLER_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <tr1/unordered_map>
+#include <pthread.h>
+
+#include <podofo/podofo.h>
+
+#include "spot-matcher.h"
+#include "run-stats.h"
+
+struct ColorReference
+// Color array given by indirect reference or written directly into
+// a dictionary. Direct array is found from the nearest indirect object
+// by the path of dictionary keys, so the same ColorReference is valid
+// in every copy of the document, e.g. those of page scanning threads.
+{
+    ColorReference() {}
+    explicit ColorReference( const PoDoFo::PdfReference & object )
+        : object( object )
+    {}
+
+    bool operator== ( const ColorReference & other ) const
+    {
+        return object == other.object && path == other.path;
+    }
+
+    // Indirect array itself, or the object holding its dictionary
+    PoDoFo::PdfReference object;
+    // Keys leading from object to the array, empty for indirect array
+    std::vector<PoDoFo::PdfName> path;
+};
+
+// Returns a vector with references to color description arrays used by
+// pdf document pages, their form XObjects, patterns, shadings and
+// annotation appearances, every reference listed once
+std::vector<ColorReference> GetColorReferences(
+                                const PoDoFo::PdfMemDocument & pdfDocument );
+
+struct PdfSource
+// File or memory buffer a document was loaded from, so that page
+// scanning threads can load their own copies of the document
+{
+    explicit PdfSource( const std::string & fileName )
+        : fileName( fileName ),
+          data( NULL ),
+          size( 0 )
+    {}
+
+    PdfSource( const char* data, size_t size )
+        : data( data ),
+          size( size )
+    {}
+
+    std::string fileName;
+    const char* data;
+    size_t size;
+};
+
+// Same as GetColorReferences( pdfDocument ) with page ranges scanned
+// on up to threadCount threads. PoDoFo parses objects on demand and
+// its documents can not be shared between threads, so every thread
+// but one loads its own copy of the document from source. The number
+// of copies is limited by input size. Cpu time of the threads is added
+// by AddWorkerCpuTime().
+// If referencePages is given, (*referencePages)[i] receives ascending
+// indexes of pages using the i-th returned array.
+std::vector<ColorReference> GetColorReferences(
+                    const PoDoFo::PdfMemDocument & pdfDocument,
+                    const PdfSource & source,
+                    unsigned int threadCount,
+                    std::vector< std::vector<int> >* referencePages = NULL );
+
+// Returns names of Separation, DeviceN and NChannel spots found
+// in colorReferences arrays
+std::vector<std::string> ListAvailableSpots(
+                    const PoDoFo::PdfMemDocument & pdfDocument,
+                    const std::vector<ColorReference> & colorReferences,
+                    RunStats & stats );
+
+struct SpotUsage
+// Where one spot of a document is used, see GetSpotUsage()
+{
+    SpotUsage()
+        : colorSpaceCount( 0 )
+    {}
+
+    std::string name;
+    // Family of the alternate space of the first array with the spot,
+    // like DeviceCMYK or ICCBased
+    std::string alternateSpace;
+    // Number of color arrays naming the spot
+    unsigned long colorSpaceCount;
+    // Ascending numbers of pages using the spot, starting from 1
+    std::vector<int> pages;
+};
+
+// Returns every unique spot of colorReferences arrays once, in order
+// of first appearance. referencePages are the page indexes filled by
+// GetColorReferences(), pages are left empty if it is empty.
+std::vector<SpotUsage> GetSpotUsage(
+                    const PoDoFo::PdfMemDocument & pdfDocument,
+                    const std::vector<ColorReference> & colorReferences,
+                    const std::vector< std::vector<int> > & referencePages,
+                    RunStats & stats );
+
+// Checks if decoded spotName must be disabled according to spotsToDisable list
+bool MustBeDisabled( const std::string & spotName,
+                     const SpotMatcher & spotsToDisable );
+
+class SpotDecisions
+// Remembers MustBeDisabled() result for every distinct spot name,
+// so that each name is matched only once per run.
+// Can be shared by documents processed in different threads.
+{
+public:
+    explicit SpotDecisions( const SpotMatcher & spotsToDisable );
+    ~SpotDecisions();
+
+    bool MustBeDisabled( const std::string & spotName );
+
+    unsigned long GetLookupCount() const { return lookupCount; }
+    unsigned long GetHitCount() const { return hitCount; }
+
+private:
+    const SpotMatcher & spotsToDisable;
+    std::tr1::unordered_map<std::string, bool> decisions;
+    unsigned long lookupCount;
+    unsigned long hitCount;
+    pthread_mutex_t mutex;
+
+    SpotDecisions( const SpotDecisions & );
+    SpotDecisions & operator= ( const SpotDecisions & );
+};
+
+struct DisabledSpot
+// Colorant name replaced by DisableSpots() and its original value
+{
+    // Indirect object holding the array of names, written by
+    // incremental update, and the array itself
+    PoDoFo::PdfObject* changedObject;
+    PoDoFo::PdfArray* names;
+    size_t index;
+    PoDoFo::PdfName spotName;
+};
+
+// Replaces names of spots from spotsToDisable list with /None.
+// Every name is appended to disabledSpots before it is replaced, so that
+// changes can be undone even if an exception stops the rewrite.
+void DisableSpots( PoDoFo::PdfMemDocument & pdfDocument,
+                   const std::vector<ColorReference> & colorReferences,
+                   SpotDecisions & spotsToDisable,
+                   RunStats & stats,
+                   std::vector<DisabledSpot> & disabledSpots );
+
+// Puts back spot names replaced by DisableSpots()
+void RestoreSpots( const std::vector<DisabledSpot> & disabledSpots );
+
+struct OutputOptions
+// How output pdf files are written
+{
+    OutputOptions()
+        : incremental( false ),
+          compressed( false ),
+          threadCount( 1 )
+    {}
+
+    // Keep original bytes and append only changed objects
+    bool incremental;
+    // Pack objects into compressed object streams with xref stream
+    bool compressed;
+    // Threads working on one file: page scanning
+    // and object streams compression
+    unsigned int threadCount;
+};
+
+// Writes pdf document to outputDevice according to outputOptions.
+// Incremental update copies source, which pdfDocument was loaded from,
+// and appends the objects changed by disabledSpots.
+// Returns number of bytes written.
+unsigned long long WriteDocument( PoDoFo::PdfMemDocument & pdfDocument,
+                            const PdfSource & source,
+                            const std::vector<DisabledSpot> & disabledSpots,
+                            PoDoFo::PdfOutputDevice & outputDevice,
+                            const OutputOptions & outputOptions );
+
+class MemoryStreamBuffer : public std::streambuf
+// Read only seekable stream over memory buffer, which is not copied
+{
+public:
+    MemoryStreamBuffer( const char* data, size_t size );
+
+protected:
+    pos_type seekoff( off_type offset, std::ios_base::seekdir direction,
+                      std::ios_base::openmode mode );
+    pos_type seekpos( pos_type position, std::ios_base::openmode mode );
+};
+
+class SpotDisabler
+// Lists and disables spots of one pdf document held in memory,
+// for programs embedding the spot disabler instead of running it.
+// Errors are reported with PoDoFo::PdfError or std::exception.
+{
+public:
+    // Parses pdf data. Data is read in place and must outlive
+    // SpotDisabler, because objects are parsed on demand and
+    // incremental update copies it to the output.
+    SpotDisabler( const char* data, size_t size );
+
+    // Names of all separation spots of the document
+    std::vector<std::string> ListSpots();
+
+    // Disables spots matching spotsToDisable, returns number of
+    // disabled color arrays. Spots stay disabled until RestoreSpots().
+    unsigned long DisableSpots( SpotDecisions & spotsToDisable );
+    // Empty spotNames list disables all spots
+    unsigned long DisableSpots( const std::vector<std::string> & spotNames );
+    // Undoes all DisableSpots() calls
+    void RestoreSpots();
+
+    // Threads scanning pages and compressing output, 1 by default
+    void SetThreadCount( unsigned int threadCount );
+
+    // Writes the document in its current state, returns number of bytes
+    unsigned long long Write( std::ostream & output,
+                              const OutputOptions & outputOptions );
+
+    const RunStats & GetStats() const { return stats; }
+    PoDoFo::PdfMemDocument & GetDocument() { return pdfDocument; }
+
+private:
+    const std::vector<ColorReference> & GetColorReferences();
+
+    // Parser reads data through these until the document is destroyed
+    MemoryStreamBuffer dataBuffer;
+    std::istream dataStream;
+    PdfSource source;
+    unsigned int threadCount;
+    PoDoFo::PdfMemDocument pdfDocument;
+    bool scanned;
+    std::vector<ColorReference> colorReferences;
+    std::vector<DisabledSpot> disabledSpots;
+    RunStats stats;
+
+    SpotDisabler( const SpotDisabler & );
+    SpotDisabler & operator= ( const SpotDisabler & );
+};
+
+#endif // SPOT_DISABLER_H
@@ -0,0 +1,122 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "spot-matcher.h"
+
+#include <cctype>
+#include <queue>
+
+SpotMatcher::SpotMatcher( const std::vector<std::string> & spotNames )
+    : matchesAll( spotNames.empty() )
+{
+    const int ROOT = AddState();
+
+    // Build the trie of lowercase names. Missing transitions are -1.
+    std::vector<std::string>::const_iterator it;
+    for ( it = spotNames.begin(); it != spotNames.end(); ++it )
+    {
+        // Empty name is contained in any spot name
+        if ( it->empty() ) matchesAll = true;
+        int state = ROOT;
+        for ( size_t i = 0; i < it->size(); ++i )
+        {
+            unsigned char symbol = std::tolower(
+                                    static_cast<unsigned char>( (*it)[i] ) );
+            if ( Transition( state, symbol ) < 0 )
+            {
+                int newState = AddState();
+                Transition( state, symbol ) = newState;
+            }
+            state = Transition( state, symbol );
+        }
+        accepting[state] = true;
+    }
+
+    /* Turn the trie into a complete automaton breadth-first:
+     * missing transitions follow the failure link of the state,
+     * and a state accepts if its failure state accepts.
+     */
+    std::vector<int> failure( accepting.size(), ROOT );
+    std::queue<int> pending;
+    for ( int symbol = 0; symbol < ALPHABET_SIZE; ++symbol )
+    {
+        int & next = Transition( ROOT, symbol );
+        if ( next < 0 )
+        {
+            next = ROOT;
+        }
+        else
+        {
+            failure[next] = ROOT;
+            pending.push( next );
+        }
+    }
+    while ( not pending.empty() )
+    {
+        int state = pending.front();
+        pending.pop();
+        if ( accepting[failure[state]] ) accepting[state] = true;
+        for ( int symbol = 0; symbol < ALPHABET_SIZE; ++symbol )
+        {
+            int fallback = Transition( failure[state], symbol );
+            int & next = Transition( state, symbol );
+            if ( next < 0 )
+            {
+                next = fallback;
+            }
+            else
+            {
+                failure[next] = fallback;
+                pending.push( next );
+            }
+        }
+    }
+}
+
+bool SpotMatcher::Matches( const std::string & spotName ) const
+{
+    if ( matchesAll ) return true;
+
+    int state = 0;
+    for ( size_t i = 0; i < spotName.size(); ++i )
+    {
+        state = Transition( state, std::tolower(
+                                static_cast<unsigned char>( spotName[i] ) ) );
+        if ( accepting[state] ) return true;
+    }
+    return false;
+}
+
+int SpotMatcher::AddState()
+{
+    transitions.resize( transitions.size() + ALPHABET_SIZE, -1 );
+    accepting.push_back( false );
+    return accepting.size() - 1;
+}
+
+int & SpotMatcher::Transition( int state, unsigned char symbol )
+{
+    return transitions[state * ALPHABET_SIZE + symbol];
+}
+
+int SpotMatcher::Transition( int state, unsigned char symbol ) const
+{
+    return transitions[state * ALPHABET_SIZE + symbol];
+}
@@ -0,0 +1,53 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef SPOT_MATCHER_H
+#define SPOT_MATCHER_H
+
+#include <string>
+#include <vector>
+
+class SpotMatcher
+// Case independent search of many partial spot names at once.
+// Names are compiled into Aho-Corasick automaton, so that every spot name
+// is matched in a single pass regardless of the number of given names.
+{
+public:
+    // Empty spotNames list matches every spot
+    explicit SpotMatcher( const std::vector<std::string> & spotNames );
+
+    // True if spotName contains any of the given names
+    bool Matches( const std::string & spotName ) const;
+
+private:
+    static const int ALPHABET_SIZE = 256;
+
+    int AddState();
+    int & Transition( int state, unsigned char symbol );
+    int Transition( int state, unsigned char symbol ) const;
+
+    bool matchesAll;
+    // Dense transition table, ALPHABET_SIZE entries per state
+    std::vector<int> transitions;
+    // True for states where at least one of the names ends
+    std::vector<bool> accepting;
+};
+
+#endif // SPOT_MATCHER_H
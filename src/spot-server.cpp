@@ -0,0 +1,315 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "spot-server.h"
+
+#include <iostream>
+#include <set>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "worker-pool.h"
+
+namespace
+{
+
+// Longest request line accepted, requests are two file names
+const size_t MAX_REQUEST_SIZE = 64 * 1024;
+// Connection idle for so many seconds is closed to free its thread
+const int IDLE_TIMEOUT = 30;
+// Accepted connections, served and queued, per pool thread. Clients
+// over the limit wait in the listen backlog of the kernel.
+const unsigned int CONNECTIONS_PER_THREAD = 2;
+
+volatile sig_atomic_t stopRequested = 0;
+// Signal handler and finished connections write to it to wake up poll()
+// of the accepting thread, so that a signal coming just before poll()
+// is not lost and accepting resumes once there is room for a connection
+int wakePipe[2] = { -1, -1 };
+
+void RequestStop( int )
+{
+    int savedErrno = errno;
+    stopRequested = 1;
+    if ( write( wakePipe[1], "", 1 ) < 0 ) {}
+    errno = savedErrno;
+}
+
+bool SendAll( int socket, const std::string & data )
+{
+    size_t sent = 0;
+    while ( sent < data.size() )
+    {
+        // Client may go away at any moment, that must not kill the server
+        ssize_t result = send( socket, data.data() + sent, data.size() - sent,
+                               MSG_NOSIGNAL );
+        if ( result < 0 )
+        {
+            if ( errno == EINTR ) continue;
+            return false;
+        }
+        sent += result;
+    }
+    return true;
+}
+
+class OpenConnections
+// Sockets of accepted connections, so that stop can end them
+// and the accepting thread can limit their number
+{
+public:
+    OpenConnections() { pthread_mutex_init( &mutex, NULL ); }
+    ~OpenConnections() { pthread_mutex_destroy( &mutex ); }
+
+    void Add( int socket )
+    {
+        MutexLock lock( mutex );
+        sockets.insert( socket );
+    }
+
+    // Must be called before socket is closed
+    void Remove( int socket )
+    {
+        {
+            MutexLock lock( mutex );
+            sockets.erase( socket );
+        }
+        // Pipe full of wake ups wakes the accepting thread as well
+        if ( write( wakePipe[1], "", 1 ) < 0 ) {}
+    }
+
+    size_t GetCount()
+    {
+        MutexLock lock( mutex );
+        return sockets.size();
+    }
+
+    // Makes blocked and further recv() return end of file, so that
+    // every connection ends after the request being handled
+    void ShutdownAll()
+    {
+        MutexLock lock( mutex );
+        std::set<int>::const_iterator it;
+        for ( it = sockets.begin(); it != sockets.end(); ++it )
+            shutdown( *it, SHUT_RD );
+    }
+
+private:
+    pthread_mutex_t mutex;
+    std::set<int> sockets;
+};
+
+class ConnectionTask : public WorkerTask
+// Serves one client connection. Deletes itself when finished.
+{
+public:
+    ConnectionTask( int socket, SpotRequestHandler & handler,
+                    OpenConnections & connections )
+        : socket( socket ), handler( handler ), connections( connections )
+    {
+        connections.Add( socket );
+    }
+
+    void Run()
+    {
+        std::string buffer;
+        char chunk[4096];
+        bool connected = true;
+        while ( connected )
+        {
+            // Fails with EAGAIN when the idle timeout expires
+            ssize_t received = recv( socket, chunk, sizeof(chunk), 0 );
+            if ( received < 0 && errno == EINTR ) continue;
+            if ( received <= 0 ) break;
+            buffer.append( chunk, received );
+
+            size_t lineEnd;
+            while ( connected && not stopRequested
+                    && ( lineEnd = buffer.find( '\n' ) ) != std::string::npos )
+            {
+                std::string request = buffer.substr( 0, lineEnd );
+                buffer.erase( 0, lineEnd + 1 );
+                if ( not request.empty()
+                     && request[request.size() - 1] == '\r' )
+                    request.erase( request.size() - 1 );
+                if ( request.empty() ) continue;
+                connected = SendAll( socket, handler.Handle( request ) + "\n" );
+            }
+            // Client sending a line without end would exhaust memory
+            if ( buffer.size() > MAX_REQUEST_SIZE ) break;
+        }
+        connections.Remove( socket );
+        close( socket );
+        delete this;
+    }
+
+private:
+    int socket;
+    SpotRequestHandler & handler;
+    OpenConnections & connections;
+};
+
+} // namespace
+
+int RunSpotServer( const std::string & socketPath,
+                   SpotRequestHandler & handler,
+                   unsigned int threadCount )
+{
+    struct sockaddr_un address;
+    memset( &address, 0, sizeof(address) );
+    address.sun_family = AF_UNIX;
+    if ( socketPath.empty() || socketPath.size() >= sizeof(address.sun_path) )
+    {
+        std::cout << "Invalid socket path " << socketPath << std::endl;
+        return 1;
+    }
+    strcpy( address.sun_path, socketPath.c_str() );
+
+    int listener = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( listener < 0 )
+    {
+        std::cout << "Can not create socket: " << strerror( errno )
+                  << std::endl;
+        return 1;
+    }
+    // Socket file left by previous run would make bind() fail,
+    // but anything else at socketPath is not ours to remove
+    struct stat status;
+    if ( lstat( socketPath.c_str(), &status ) == 0 )
+    {
+        if ( not S_ISSOCK( status.st_mode ) )
+        {
+            std::cout << "Not a socket, refusing to replace " << socketPath
+                      << std::endl;
+            close( listener );
+            return 1;
+        }
+        unlink( socketPath.c_str() );
+    }
+    if ( bind( listener, reinterpret_cast<struct sockaddr*>( &address ),
+               sizeof(address) ) != 0
+         || listen( listener, SOMAXCONN ) != 0 )
+    {
+        std::cout << "Can not listen on " << socketPath << ": "
+                  << strerror( errno ) << std::endl;
+        close( listener );
+        return 1;
+    }
+
+    // Listener is polled together with wakePipe, accept() must not
+    // block if the client has gone away meanwhile
+    if ( pipe( wakePipe ) != 0
+         || fcntl( wakePipe[0], F_SETFL, O_NONBLOCK ) != 0
+         || fcntl( wakePipe[1], F_SETFL, O_NONBLOCK ) != 0
+         || fcntl( listener, F_SETFL, O_NONBLOCK ) != 0 )
+    {
+        std::cout << "Can not create wake pipe: " << strerror( errno )
+                  << std::endl;
+        close( listener );
+        unlink( socketPath.c_str() );
+        return 1;
+    }
+
+    struct sigaction action, previousInt, previousTerm;
+    memset( &action, 0, sizeof(action) );
+    action.sa_handler = RequestStop;
+    sigemptyset( &action.sa_mask );
+    sigaction( SIGINT, &action, &previousInt );
+    sigaction( SIGTERM, &action, &previousTerm );
+
+    // Pool threads inherit blocked signals, so only this thread gets them
+    sigset_t stopSignals;
+    sigemptyset( &stopSignals );
+    sigaddset( &stopSignals, SIGINT );
+    sigaddset( &stopSignals, SIGTERM );
+    pthread_sigmask( SIG_BLOCK, &stopSignals, NULL );
+    WorkerPool* pool = new WorkerPool( threadCount );
+    pthread_sigmask( SIG_UNBLOCK, &stopSignals, NULL );
+    OpenConnections connections;
+    const size_t maxConnections = CONNECTIONS_PER_THREAD * threadCount;
+
+    std::cout << "Listening on " << socketPath << std::endl;
+    bool failed = false;
+    while ( not stopRequested )
+    {
+        // Listener is not polled while the pool has enough work,
+        // negative descriptor is ignored by poll()
+        struct pollfd events[2];
+        events[0].fd = connections.GetCount() < maxConnections ? listener
+                                                               : -1;
+        events[0].events = POLLIN;
+        events[0].revents = 0;
+        events[1].fd = wakePipe[0];
+        events[1].events = POLLIN;
+        if ( poll( events, 2, -1 ) < 0 )
+        {
+            if ( errno == EINTR ) continue;
+            std::cout << "Can not wait for connection: "
+                      << strerror( errno ) << std::endl;
+            failed = true;
+            break;
+        }
+        if ( events[1].revents & POLLIN )
+        {
+            char wakeUps[64];
+            while ( read( wakePipe[0], wakeUps, sizeof(wakeUps) ) > 0 ) {}
+        }
+        if ( not ( events[0].revents & POLLIN ) ) continue;
+
+        int connection = accept( listener, NULL, NULL );
+        if ( connection < 0 )
+        {
+            if ( errno == EINTR || errno == ECONNABORTED
+                 || errno == EAGAIN || errno == EWOULDBLOCK ) continue;
+            std::cout << "Can not accept connection: "
+                      << strerror( errno ) << std::endl;
+            failed = true;
+            break;
+        }
+        // Some systems pass O_NONBLOCK of the listener to the connection
+        fcntl( connection, F_SETFL, 0 );
+        struct timeval timeout;
+        timeout.tv_sec = IDLE_TIMEOUT;
+        timeout.tv_usec = 0;
+        setsockopt( connection, SOL_SOCKET, SO_RCVTIMEO,
+                    &timeout, sizeof(timeout) );
+        pool->Add( new ConnectionTask( connection, handler, connections ) );
+    }
+    // Open and queued connections end after their current request,
+    // pool destructor waits for them
+    connections.ShutdownAll();
+    delete pool;
+    close( listener );
+    unlink( socketPath.c_str() );
+    // Handler must not write to the pipe once it is closed
+    sigaction( SIGINT, &previousInt, NULL );
+    sigaction( SIGTERM, &previousTerm, NULL );
+    close( wakePipe[0] );
+    close( wakePipe[1] );
+    return failed ? 1 : 0;
+}
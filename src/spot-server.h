@@ -0,0 +1,47 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef SPOT_SERVER_H
+#define SPOT_SERVER_H
+
+#include <string>
+
+class SpotRequestHandler
+// Processing of server requests. Called from many threads at once.
+{
+public:
+    virtual ~SpotRequestHandler() {}
+    // Returns one line response to one line request. Must not throw.
+    virtual std::string Handle( const std::string & request ) = 0;
+};
+
+// Listens on Unix domain socket socketPath and answers every request line
+// of every connection with handler. Connections are served by a pool of
+// threadCount threads, the rest wait in queue. At most twice threadCount
+// connections are accepted at once, others wait to be accepted until
+// some connection ends. Connections idle for 30 seconds or sending a line
+// over 64 KB are closed. Runs until SIGINT or SIGTERM, then answers
+// requests being handled, closes all connections and returns.
+// Returns program exit code.
+int RunSpotServer( const std::string & socketPath,
+                   SpotRequestHandler & handler,
+                   unsigned int threadCount );
+
+#endif // SPOT_SERVER_H
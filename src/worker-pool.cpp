@@ -0,0 +1,128 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#include "worker-pool.h"
+
+#include <unistd.h>
+
+MutexLock::MutexLock( pthread_mutex_t & mutex )
+    : lockedMutex( mutex )
+{
+    pthread_mutex_lock( &lockedMutex );
+}
+
+MutexLock::~MutexLock()
+{
+    pthread_mutex_unlock( &lockedMutex );
+}
+
+WorkerPool::WorkerPool( unsigned int threadCount )
+    : runningTasks( 0 ),
+      stopping( false )
+{
+    pthread_mutex_init( &mutex, NULL );
+    pthread_cond_init( &taskAdded, NULL );
+    pthread_cond_init( &tasksDone, NULL );
+
+    if ( threadCount < 1 ) threadCount = 1;
+    for ( unsigned int i = 0; i < threadCount; ++i )
+    {
+        pthread_t thread;
+        // Pool works with fewer threads if system refuses to create more
+        if ( pthread_create( &thread, NULL, ThreadMain, this ) != 0 ) break;
+        threads.push_back( thread );
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    Wait();
+    {
+        MutexLock lock( mutex );
+        stopping = true;
+        pthread_cond_broadcast( &taskAdded );
+    }
+    for ( size_t i = 0; i < threads.size(); ++i )
+        pthread_join( threads[i], NULL );
+
+    pthread_cond_destroy( &tasksDone );
+    pthread_cond_destroy( &taskAdded );
+    pthread_mutex_destroy( &mutex );
+}
+
+void WorkerPool::Add( WorkerTask* task )
+{
+    // Without threads the task is run by the caller
+    if ( threads.empty() )
+    {
+        task->Run();
+        return;
+    }
+    MutexLock lock( mutex );
+    tasks.push_back( task );
+    pthread_cond_signal( &taskAdded );
+}
+
+void WorkerPool::Wait()
+{
+    MutexLock lock( mutex );
+    while ( not tasks.empty() || runningTasks > 0 )
+        pthread_cond_wait( &tasksDone, &mutex );
+}
+
+unsigned int WorkerPool::GetThreadCount() const
+{
+    return threads.size();
+}
+
+unsigned int WorkerPool::GetDefaultThreadCount()
+{
+    long processors = sysconf( _SC_NPROCESSORS_ONLN );
+    return processors > 0 ? processors : 1;
+}
+
+void* WorkerPool::ThreadMain( void* pool )
+{
+    static_cast<WorkerPool*>( pool )->RunTasks();
+    return NULL;
+}
+
+void WorkerPool::RunTasks()
+{
+    MutexLock lock( mutex );
+    while ( true )
+    {
+        while ( tasks.empty() && not stopping )
+            pthread_cond_wait( &taskAdded, &mutex );
+        if ( tasks.empty() ) return;
+
+        WorkerTask* task = tasks.front();
+        tasks.pop_front();
+        ++runningTasks;
+
+        pthread_mutex_unlock( &mutex );
+        task->Run();
+        pthread_mutex_lock( &mutex );
+
+        --runningTasks;
+        if ( tasks.empty() && runningTasks == 0 )
+            pthread_cond_broadcast( &tasksDone );
+    }
+}
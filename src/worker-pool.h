@@ -0,0 +1,83 @@
+/***************************************************************************
+ *   Copyright (C) 2013 by Pavlo Oleshkevych                               *
+ *   oleshkevych@gmail.com                                                 *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.             *
+ ***************************************************************************/
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+class MutexLock
+// Locks given mutex for the lifetime of the object
+{
+public:
+    explicit MutexLock( pthread_mutex_t & mutex );
+    ~MutexLock();
+private:
+    pthread_mutex_t & lockedMutex;
+    MutexLock( const MutexLock & );
+    MutexLock & operator= ( const MutexLock & );
+};
+
+class WorkerTask
+// Unit of work being run by WorkerPool
+{
+public:
+    virtual ~WorkerTask() {}
+    // Called from one of the pool threads. Must not throw.
+    virtual void Run() = 0;
+};
+
+class WorkerPool
+// Fixed-size pool of threads running queued tasks.
+// Pool does not own the tasks, they must live until Wait() returns.
+{
+public:
+    explicit WorkerPool( unsigned int threadCount );
+    // Waits for all queued tasks and stops the threads
+    ~WorkerPool();
+
+    // Queues task to be run by the first free thread
+    void Add( WorkerTask* task );
+    // Blocks until all queued tasks are finished
+    void Wait();
+
+    unsigned int GetThreadCount() const;
+    // Number of online processors, at least 1
+    static unsigned int GetDefaultThreadCount();
+
+private:
+    static void* ThreadMain( void* pool );
+    void RunTasks();
+
+    pthread_mutex_t mutex;
+    pthread_cond_t taskAdded;
+    pthread_cond_t tasksDone;
+    std::deque<WorkerTask*> tasks;
+    std::vector<pthread_t> threads;
+    unsigned int runningTasks;
+    bool stopping;
+
+    WorkerPool( const WorkerPool & );
+    WorkerPool & operator= ( const WorkerPool & );
+};
+
+#endif // WORKER_POOL_H